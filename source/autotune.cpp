@@ -0,0 +1,83 @@
+/*******************************************************************************
+ * Copyright (c) 2019 Paul Stahr
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ ******************************************************************************/
+
+#include <vector>
+#include <algorithm>
+#include <cstdlib>
+#include "autotune.h"
+#include "bitset_map.h"
+#include "dijkstra_steiner.h"
+
+/*Bytes the trie roots of all vertices may take before the tries get more than one layer. Up to 12 terminals a single
+layer was never slower than narrower ones, wider keys are split into layers of autotune_layer_bits*/
+static const size_t autotune_flat_trie_bytes = size_t(1) << 26;
+static const size_t autotune_layer_bits = 10;
+
+void compute_instance_features(std::vector<std::vector <COOR> > const & terminals, instance_features & features)
+{
+   size_t num_terminals = terminals.size();
+   size_t dim = terminals[0].size();
+   features._num_terminals = num_terminals;
+   features._dim = dim;
+   features._num_vertices = 1;
+   for (size_t a = 0; a < dim; ++a)
+   {
+      std::vector<COOR> coords;
+      coords.reserve(num_terminals);
+      for (std::vector<COOR> const & t : terminals)
+      {
+         coords.push_back(t[a]);
+      }
+      std::sort(coords.begin(), coords.end());
+      features._num_vertices *= std::distance(coords.begin(), std::unique(coords.begin(), coords.end()));
+   }
+   /*The medoid was the best predictor for the number of extracted labels among the central and extreme terminals*/
+   DISTANCE_T medoid_distance = 0;
+   features._medoid = 0;
+   for (size_t i = 0; i < num_terminals; ++i)
+   {
+      DISTANCE_T distance = 0;
+      for (size_t j = 0; j < num_terminals; ++j)
+      {
+         for (size_t a = 0; a < dim; ++a)
+         {
+            distance += std::abs(terminals[i][a] - terminals[j][a]);
+         }
+      }
+      if (i == 0 || distance < medoid_distance)
+      {
+         medoid_distance = distance;
+         features._medoid = i;
+      }
+   }
+}
+
+void autotune(instance_features const & features, autotune_choice & choice)
+{
+   choice._root = features._medoid;
+   size_t num_keyed_terminals = features._num_terminals - 1;
+   choice._maximum_heap_width = num_keyed_terminals;
+   if (features._num_vertices * BitSetMap<light_node>::root_memory_usage(num_keyed_terminals, num_keyed_terminals) > autotune_flat_trie_bytes)
+   {
+      choice._maximum_heap_width = autotune_layer_bits;
+   }
+}
@@ -0,0 +1,50 @@
+/*******************************************************************************
+ * Copyright (c) 2019 Paul Stahr
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ ******************************************************************************/
+
+#ifndef AUTOTUNE_H
+#define AUTOTUNE_H
+
+#include <vector>
+#include "util.h"
+
+/*Features of a coordinate instance which are cheap to compute before the hanan grid is built*/
+struct instance_features{
+   size_t _num_terminals;
+   size_t _dim;
+   size_t _num_vertices;                   /*vertices of the hanan grid*/
+   size_t _medoid;                         /*terminal with the smallest sum of distances to all others*/
+};
+
+void compute_instance_features(std::vector<std::vector <COOR> > const & terminals, instance_features & features);
+
+/*Solver knobs chosen by fixed rules, not by a fitted cost model: the medoid as root and the widest trie that fits
+autotune_flat_trie_bytes. benchmark --autotune checks the rules against the default knobs and every root.
+The lower bound is not chosen, the small subset bound was faster than the bounding box bound on only 4 of the
+48 benchmarked instances, with no feature separating them, so the caller's bound is kept*/
+struct autotune_choice{
+   size_t _root;                           /*terminal to be used as the root of the search*/
+   size_t _maximum_heap_width;
+};
+
+void autotune(instance_features const & features, autotune_choice & choice);
+
+#endif
@@ -0,0 +1,906 @@
+/*******************************************************************************
+ * Copyright (c) 2019 Paul Stahr
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ ******************************************************************************/
+
+/*Benchmarks of the solver and its data structures. Every benchmark prints one line
+<name> <repetitions> <median ns> <min ns> <checksum>
+which can be stored as baseline and compared against with --baseline <file>.
+--fuzz reruns fixed regression inputs and compares the labelling algorithm and the sweep engine against the subset dynamic program on random small instances,
+--crossover reports which engine is fastest depending on grid size and number of terminals,
+--calibrate fits the resource estimator to searches of random instances*/
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <chrono>
+#include <random>
+#include <algorithm>
+#include <map>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+#include <cstdlib>
+#include <numeric>
+#include <cmath>
+#include <limits>
+#include "heap.h"
+#include "bitset_map.h"
+#include "util.h"
+#include "dijkstra_steiner.h"
+#include "instance_generator.h"
+#include "dreyfus_wagner.h"
+#include "sweep_steiner.h"
+#include "autotune.h"
+#include "estimator.h"
+
+struct bench_result{
+   std::string _name;
+   size_t _repetitions;
+   double _median;
+   double _min;
+   uint64_t _checksum;
+};
+
+struct bench_options{
+   std::string _filter;
+   std::string _baseline;
+   double _min_seconds;
+   double _tolerance;
+   size_t _fuzz_instances;
+   bool _crossover;
+   bool _epsilon;
+   bool _autotune;
+   bool _calibrate;
+
+   bench_options() : _min_seconds(0.5), _tolerance(0.1), _fuzz_instances(0), _crossover(false), _epsilon(false), _autotune(false), _calibrate(false){}
+};
+
+/*Repeats the function until min_seconds have passed, the function returns a checksum of its result*/
+template <typename Function>
+bench_result run_benchmark(std::string const & name, bench_options const & options, Function function)
+{
+   bench_result result;
+   result._name = name;
+   result._checksum = 0;
+   std::vector<double> times;
+   double total = 0;
+   while (times.size() < 3 || (total < options._min_seconds && times.size() < 1000))
+   {
+      auto begin = std::chrono::steady_clock::now();
+      result._checksum = function();
+      double elapsed = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - begin).count();
+      times.push_back(elapsed);
+      total += elapsed * 1e-9;
+   }
+   std::sort(times.begin(), times.end());
+   result._repetitions = times.size();
+   result._median = times[times.size() / 2];
+   result._min = times.front();
+   return result;
+}
+
+struct bench_node_comparator{
+   bool operator()(node const *lhs, node const *rhs) const{return lhs->_lower_bound_steinerlength < rhs->_lower_bound_steinerlength;}
+};
+
+struct bench_node_index_set{
+   void operator()(node *n, size_t index) const{n->_heap_index = index;}
+};
+
+void solver_benchmarks(bench_options const & options, std::vector<bench_result> & results)
+{
+   struct solver_case{size_t _dim; size_t _num_terminals; COOR _range;};
+   solver_case const cases[] = {{2, 7, 1000}, {2, 8, 1000}, {2, 20, 1000}, {2, 40, 1000}, {2, 1000, 100000}, {3, 6, 100}, {3, 8, 100}, {3, 500, 10000}, {4, 6, 100}};
+   terminal_distribution const distributions[] = {UNIFORM_TERMINALS, CLUSTERED_TERMINALS, COLLINEAR_TERMINALS, GRID_ALIGNED_TERMINALS};
+   for (terminal_distribution distribution : distributions)
+   {
+      for (solver_case const & c : cases)
+      {
+         std::stringstream name;
+         name << "solve/" << terminal_distribution_name(distribution) << "/d" << c._dim << "/k" << c._num_terminals;
+         if (name.str().find(options._filter) == std::string::npos)
+         {
+            continue;
+         }
+         std::vector<std::vector<COOR> > terminals;
+         try
+         {
+            generate_terminals(distribution, c._dim, c._num_terminals, c._range, c._num_terminals * 31 + c._dim, terminals);
+         }
+         catch (std::runtime_error const &)
+         {
+            continue;
+         }
+         for (bool dense_sweep : {false, true})
+         {
+            if (dense_sweep && c._num_terminals > 8)
+            {
+               continue;
+            }
+            dijkstra_steiner_settings settings;
+            settings._maximum_heap_width = 20;
+            settings._heuristic_threshold = 64;   //the largest cases are solved heuristically from windows
+            settings._heuristic_threshold_high_dim = 14;
+            settings._dense_sweep = dense_sweep;
+            results.push_back(run_benchmark(name.str() + (dense_sweep ? "/sweep" : ""), options, [&]()
+            {
+               std::vector<std::vector<COOR> > steinerpoints;
+               std::vector<std::pair<size_t, size_t> > edges;
+               return uint64_t(calculate_steinertree(*boundingbox_lower_bound, terminals, settings, steinerpoints, edges));
+            }));
+            std::cout << results.back()._name << ' ' << results.back()._repetitions << ' ' << uint64_t(results.back()._median) << ' ' << uint64_t(results.back()._min) << ' ' << results.back()._checksum << std::endl;
+         }
+      }
+   }
+}
+
+void micro_benchmarks(bench_options const & options, std::vector<bench_result> & results)
+{
+   std::vector<std::pair<std::string, std::function<uint64_t()> > > benchmarks;
+   size_t const num_bits = 16;
+   std::vector<light_node> items(1 << 12);
+   std::vector<BITSET> keys(100000);
+   std::mt19937 gen(1);
+   for (BITSET & key : keys)
+   {
+      key = gen() & ((BITSET(1) << num_bits) - 1);
+   }
+   for (size_t width : {4, 8, 16})
+   {
+      benchmarks.emplace_back("bitset_map/insert/w" + std::to_string(width), [&, width]()
+      {
+         BitSetMap<light_node> map(num_bits, width);
+         for (size_t i = 0; i < keys.size(); ++i)
+         {
+            map.insert_element(keys[i], items[i % items.size()]);
+         }
+         return uint64_t(map.memory_usage());
+      });
+      benchmarks.emplace_back("bitset_map/get/w" + std::to_string(width), [&, width]()
+      {
+         BitSetMap<light_node> map(num_bits, width);
+         for (size_t i = 0; i < keys.size(); i += 2)
+         {
+            map.insert_element(keys[i], items[i % items.size()]);
+         }
+         uint64_t found = 0;
+         for (size_t repeat = 0; repeat < 10; ++repeat)
+         {
+            for (BITSET key : keys)
+            {
+               found += map.get_element(key) != nullptr;
+            }
+         }
+         return found;
+      });
+   }
+
+   std::vector<node> nodes(100000);
+   for (node & n : nodes)
+   {
+      n._lower_bound_steinerlength = gen() % 100000;
+   }
+   benchmarks.emplace_back("heap/make_heap", [&]()
+   {
+      std::vector<node*> heap;
+      for (node & n : nodes)
+      {
+         heap.push_back(&n);
+      }
+      heap::make_heap(heap.begin(), heap.end(), bench_node_comparator(), bench_node_index_set());
+      return uint64_t(heap.front()->_lower_bound_steinerlength);
+   });
+   benchmarks.emplace_back("heap/push_pop", [&]()
+   {
+      std::vector<node*> heap;
+      uint64_t checksum = 0;
+      for (node & n : nodes)
+      {
+         heap.push_back(&n);
+         heap::shift_up(heap.begin(), bench_node_comparator(), bench_node_index_set(), heap.size() - 1);
+      }
+      while (!heap.empty())
+      {
+         checksum = checksum * 31 + heap.front()->_lower_bound_steinerlength;
+         heap.front() = heap.back();
+         heap.pop_back();
+         if (!heap.empty())
+         {
+            heap::shift_down(heap.begin(), heap.end(), bench_node_comparator(), bench_node_index_set(), 0);
+         }
+      }
+      return checksum;
+   });
+
+   for (size_t dim : {2, 3})
+   {
+      std::shared_ptr<steiner_instance> instance(new steiner_instance());
+      std::vector<std::vector<COOR> > terminals;
+      generate_terminals(UNIFORM_TERMINALS, dim, 10, 1000, 7, terminals);
+      create_hanan_instance(terminals, *instance);
+      benchmarks.emplace_back("boundingbox_lower_bound/d" + std::to_string(dim), [instance]()
+      {
+         std::mt19937 query_gen(3);
+         uint64_t sum = 0;
+         for (size_t i = 0; i < 100000; ++i)
+         {
+            sum += boundingbox_lower_bound(query_gen() & ((BITSET(1) << (instance->_terminals.size() - 1)) - 1), query_gen() % instance->_vertices.size(), *instance);
+         }
+         return sum;
+      });
+      benchmarks.emplace_back("small_subset_lower_bound/d" + std::to_string(dim), [instance]()
+      {
+         std::mt19937 query_gen(3);
+         uint64_t sum = 0;
+         for (size_t i = 0; i < 100000; ++i)
+         {
+            sum += small_subset_lower_bound(query_gen() & ((BITSET(1) << (instance->_terminals.size() - 1)) - 1), query_gen() % instance->_vertices.size(), *instance);
+         }
+         return sum;
+      });
+   }
+
+   for (size_t dim : {3, 4})
+   {
+      std::vector<std::vector<COOR> > terminals;
+      generate_terminals(UNIFORM_TERMINALS, dim, dim == 3 ? 40 : 14, 1000, 11, terminals);
+      benchmarks.emplace_back("create_hanan_instance/d" + std::to_string(dim), [terminals]()
+      {
+         steiner_instance instance;
+         create_hanan_instance(terminals, instance);
+         uint64_t sum = 0;
+         for (vertex const & v : instance._vertices)
+         {
+            sum += v._neighbours.size();
+         }
+         return sum;
+      });
+   }
+
+   for (auto const & benchmark : benchmarks)
+   {
+      if (benchmark.first.find(options._filter) == std::string::npos)
+      {
+         continue;
+      }
+      results.push_back(run_benchmark(benchmark.first, options, benchmark.second));
+      std::cout << results.back()._name << ' ' << results.back()._repetitions << ' ' << uint64_t(results.back()._median) << ' ' << uint64_t(results.back()._min) << ' ' << results.back()._checksum << std::endl;
+   }
+}
+
+/*Checks that the edges form a connected graph of the given length containing all terminals*/
+bool is_valid_tree(steiner_instance const & instance, std::vector<std::pair<size_t, size_t> > const & edges, DISTANCE_T length)
+{
+   std::vector<size_t> parent(instance._vertices.size());
+   for (size_t i = 0; i < parent.size(); ++i)
+   {
+      parent[i] = i;
+   }
+   std::function<size_t(size_t)> find = [&](size_t v){return parent[v] == v ? v : parent[v] = find(parent[v]);};
+   DISTANCE_T sum = 0;
+   for (std::pair<size_t, size_t> const & e : edges)
+   {
+      std::vector<COOR> const & a = instance._vertices[e.first]._coords;
+      std::vector<COOR> const & b = instance._vertices[e.second]._coords;
+      for (size_t i = 0; i < a.size(); ++i)
+      {
+         sum += std::abs(a[i] - b[i]);
+      }
+      parent[find(e.first)] = find(e.second);
+   }
+   for (size_t t : instance._terminals)
+   {
+      if (find(t) != find(instance._terminals[0]))
+      {
+         return false;
+      }
+   }
+   return sum == length;
+}
+
+/*Fixed inputs of bugs found earlier, each fails without its fix*/
+size_t regression_cases()
+{
+   size_t num_failures = 0;
+   {
+      /*make_heap skipped the last inner node, which is out of order here*/
+      std::vector<node> nodes(4);
+      DISTANCE_T const keys[] = {1, 5, 2, 0};
+      std::vector<node*> heap;
+      for (size_t i = 0; i < nodes.size(); ++i)
+      {
+         nodes[i]._lower_bound_steinerlength = keys[i];
+         heap.push_back(&nodes[i]);
+      }
+      heap::make_heap(heap.begin(), heap.end(), bench_node_comparator(), bench_node_index_set());
+      bool failed = false;
+      for (size_t i = 1; i < heap.size(); ++i)
+      {
+         failed |= heap[i]->_lower_bound_steinerlength < heap[(i - 1) / 2]->_lower_bound_steinerlength || heap[i]->_heap_index != i;
+      }
+      if (failed)
+      {
+         std::cerr << "REGRESSION heap/make_heap" << std::endl;
+         ++num_failures;
+      }
+   }
+   {
+      /*The optimal tree is a star with a terminal of degree four, so labels have to merge in the terminal*/
+      std::vector<std::vector<COOR> > const terminals = {{1, 1}, {0, 1}, {2, 1}, {1, 0}, {1, 2}};
+      steiner_instance instance;
+      create_hanan_instance(terminals, instance);
+      dijkstra_steiner_settings settings;
+      bool failed = false;
+      for (DISTANCE_T (*lower_bound)(BITSET, size_t, steiner_instance const &) : {zero_lower_bound, boundingbox_lower_bound})
+      {
+         std::vector<std::pair<size_t, size_t> > edges;
+         DISTANCE_T length = calculate_steinertree(lower_bound, instance, settings, edges);
+         failed |= length != 4 || !is_valid_tree(instance, edges, length);
+      }
+      if (failed)
+      {
+         std::cerr << "REGRESSION dijkstra_steiner/terminal_merge" << std::endl;
+         ++num_failures;
+      }
+   }
+   return num_failures;
+}
+
+/*Differential test of the labelling algorithm in several configurations against the subset dynamic program*/
+size_t fuzz(bench_options const & options)
+{
+   terminal_distribution const distributions[] = {UNIFORM_TERMINALS, CLUSTERED_TERMINALS, COLLINEAR_TERMINALS, GRID_ALIGNED_TERMINALS};
+   size_t num_failures = regression_cases();
+   for (size_t seed = 0; seed < options._fuzz_instances; ++seed)
+   {
+      std::mt19937 gen(seed);
+      terminal_distribution distribution = distributions[gen() % 4];
+      size_t dim = 2 + gen() % 3;
+      size_t num_terminals = 2 + gen() % (dim == 4 ? 5 : 7);
+      COOR range = 4 + gen() % 40;
+      std::vector<std::vector<COOR> > terminals;
+      try
+      {
+         generate_terminals(distribution, dim, num_terminals, range, seed, terminals);
+      }
+      catch (std::runtime_error const &)
+      {
+         continue;
+      }
+      steiner_instance instance;
+      create_hanan_instance(terminals, instance);
+
+      std::vector<std::pair<size_t, size_t> > reference_edges;
+      DISTANCE_T reference = calculate_steinertree_dreyfus_wagner(instance, reference_edges);
+      bool failed = !is_valid_tree(instance, reference_edges, reference);
+
+      std::vector<std::pair<size_t, size_t> > sweep_edges;
+      DISTANCE_T sweep_length = calculate_steinertree_sweep(instance, sweep_edges);
+      failed |= sweep_length != reference || !is_valid_tree(instance, sweep_edges, sweep_length);
+
+      dijkstra_steiner_settings settings;
+      settings._maximum_heap_width = 1 + gen() % 20;
+      settings._small_memory_mode = gen() % 2;
+      settings._out_of_core_mode = gen() % 4 == 0;
+      settings._superset_dominance = gen() % 2;
+      for (DISTANCE_T (*lower_bound)(BITSET, size_t, steiner_instance const &) : {zero_lower_bound, boundingbox_lower_bound, small_subset_lower_bound})
+      {
+         std::vector<std::pair<size_t, size_t> > edges;
+         DISTANCE_T length = calculate_steinertree(lower_bound, instance, settings, edges);
+         failed |= length != reference || !is_valid_tree(instance, edges, length);
+      }
+      {
+         /*Stepping in chunks has to give the same tree, with a lower bound below the optimum in between*/
+         DijkstraSteinerSearch search(*boundingbox_lower_bound, instance, settings);
+         size_t chunk = 1 + gen() % 64;
+         while (!search.step(chunk))
+         {
+            failed |= search.lower_bound() > reference;
+         }
+         std::vector<std::pair<size_t, size_t> > edges;
+         DISTANCE_T length = search.result(edges);
+         failed |= !search.is_optimal() || length != reference || !is_valid_tree(instance, edges, length);
+      }
+      if (seed % 8 == 0)
+      {
+         /*Forking the workers dominates on small instances, so only every eighth one*/
+         dijkstra_steiner_settings distributed_settings;
+         distributed_settings._distributed_workers = 1 + seed / 8 % 4;
+         std::vector<std::pair<size_t, size_t> > edges;
+         DISTANCE_T length = calculate_steinertree(*boundingbox_lower_bound, instance, distributed_settings, edges);
+         failed |= length != reference || !is_valid_tree(instance, edges, length);
+      }
+      if (seed % 8 == 2)
+      {
+         /*A label limit stops the workers early, the tree may then be longer and the lower bound below the optimum*/
+         dijkstra_steiner_settings distributed_settings;
+         distributed_settings._distributed_workers = 1 + seed / 8 % 4;
+         distributed_settings._label_limit = 1 + gen() % 256;
+         dijkstra_steiner_bounds bounds;
+         distributed_settings._bounds = &bounds;
+         std::vector<std::pair<size_t, size_t> > edges;
+         DISTANCE_T length = calculate_steinertree(*boundingbox_lower_bound, instance, distributed_settings, edges);
+         failed |= length < reference || bounds._lower_bound > reference || bounds._labels_extracted > distributed_settings._label_limit || !is_valid_tree(instance, edges, length);
+      }
+      if (seed % 8 == 4)
+      {
+         /*The portfolio works on the coordinates, so only the length is compared*/
+         dijkstra_steiner_settings portfolio_settings;
+         portfolio_settings._portfolio_threads = 2 + seed / 8 % 4;
+         portfolio_settings._memory_budget_bytes = seed / 8 % 2 == 0 ? 0 : size_t(1) << 24;
+         std::vector<std::vector<COOR> > steinerpoints;
+         std::vector<std::pair<size_t, size_t> > edges;
+         failed |= calculate_steinertree(*boundingbox_lower_bound, terminals, portfolio_settings, steinerpoints, edges) != reference;
+      }
+      settings._epsilon = 0.05 * (1 + gen() % 10);
+      std::vector<std::pair<size_t, size_t> > weighted_edges;
+      DISTANCE_T weighted_length = calculate_steinertree(*boundingbox_lower_bound, instance, settings, weighted_edges);
+      failed |= weighted_length < reference || weighted_length > reference * (1 + settings._epsilon) || !is_valid_tree(instance, weighted_edges, weighted_length);
+      if (dim == 2)
+      {
+         /*Full steiner trees are optimal without a limit, a step limit may leave a longer tree and a lower bound below the optimum*/
+         dijkstra_steiner_settings fst_settings;
+         fst_settings._full_steiner_tree_threshold = 2;
+         fst_settings._label_limit = gen() % 2 == 0 ? 0 : 1 + gen() % 64;
+         dijkstra_steiner_bounds bounds;
+         fst_settings._bounds = &bounds;
+         std::vector<std::vector<COOR> > steinerpoints;
+         std::vector<std::pair<size_t, size_t> > edges;
+         DISTANCE_T length = calculate_steinertree(*boundingbox_lower_bound, terminals, fst_settings, steinerpoints, edges);
+         failed |= length < reference || (fst_settings._label_limit == 0 && length != reference) || bounds._lower_bound > reference || bounds._upper_bound != length;
+      }
+      if (dim == 2 && seed % 4 == 1)
+      {
+         /*Above the default threshold the full steiner trees are dispatched, the subset dynamic program is too slow there, so labelling is the reference*/
+         std::vector<std::vector<COOR> > large_terminals;
+         try
+         {
+            generate_terminals(distribution, dim, 9 + gen() % 4, range, seed, large_terminals);
+         }
+         catch (std::runtime_error const &)
+         {
+            large_terminals.clear();
+         }
+         if (!large_terminals.empty())
+         {
+            dijkstra_steiner_settings labelling_settings;
+            labelling_settings._full_steiner_tree_threshold = std::numeric_limits<size_t>::max();
+            dijkstra_steiner_settings fst_settings;
+            std::vector<std::vector<COOR> > steinerpoints;
+            std::vector<std::pair<size_t, size_t> > edges;
+            DISTANCE_T labelling_length = calculate_steinertree(*boundingbox_lower_bound, large_terminals, labelling_settings, steinerpoints, edges);
+            steinerpoints.clear();
+            edges.clear();
+            failed |= calculate_steinertree(*boundingbox_lower_bound, large_terminals, fst_settings, steinerpoints, edges) != labelling_length;
+         }
+      }
+      if (failed)
+      {
+         std::cerr << "FUZZ seed " << seed << ' ' << terminal_distribution_name(distribution) << " d" << dim << " k" << num_terminals << " range " << range << std::endl;
+         ++num_failures;
+      }
+   }
+   std::cout << "fuzz " << options._fuzz_instances << " instances " << num_failures << " failures" << std::endl;
+   return num_failures;
+}
+
+/*A full grid with unit spacing, so that the grid size doesn't depend on the terminals*/
+void create_grid_instance(size_t dim, size_t side, std::vector<std::vector<COOR> > const & terminals, steiner_instance & instance)
+{
+   instance._sizes.assign(dim, side);
+   std::vector<size_t> indices(dim, 0);
+   size_t num_vertices = std::accumulate(instance._sizes.begin(), instance._sizes.end(), size_t(1), std::multiplies<size_t>());
+   for (size_t index = 0; index < num_vertices; ++index)
+   {
+      vertex v;
+      v._coords.assign(indices.begin(), indices.end());
+      v._is_excluded = false;
+      v._terminal_number = std::numeric_limits<uint8_t>::max();
+      instance._vertices.push_back(v);
+      for (size_t i = 0; i < dim && ++indices[i] == side; ++i)
+      {
+         indices[i] = 0;
+      }
+   }
+   for (size_t i = 0; i < terminals.size(); ++i)
+   {
+      size_t index = calculate_index(instance._sizes, std::vector<size_t>(terminals[i].begin(), terminals[i].end()));
+      instance._vertices[index]._terminal_number = i;
+      instance._terminals.push_back(index);
+      instance._terminal_coords.insert(instance._terminal_coords.end(), terminals[i].begin(), terminals[i].end());
+   }
+   /*Not a hanan grid, so no vertices can be excluded*/
+   update_neighbours(instance);
+}
+
+void crossover(bench_options const & options)
+{
+   struct grid_case{size_t _dim; size_t _side;};
+   grid_case const cases[] = {{2, 8}, {2, 16}, {2, 32}, {2, 64}, {3, 4}, {3, 8}, {3, 12}};
+   bench_options crossover_options(options);
+   crossover_options._min_seconds = options._min_seconds / 10;
+   std::cout << "crossover <dim> <grid side> <terminals> <labelling ns> <subset dp ns> <sweep ns> <fastest>" << std::endl;
+   for (grid_case const & c : cases)
+   {
+      for (size_t num_terminals = 4; num_terminals <= 12; num_terminals += 2)
+      {
+         std::vector<std::vector<COOR> > terminals;
+         generate_terminals(UNIFORM_TERMINALS, c._dim, num_terminals, c._side, num_terminals, terminals);
+         steiner_instance instance;
+         create_grid_instance(c._dim, c._side, terminals, instance);
+         dijkstra_steiner_settings settings;
+         settings._maximum_heap_width = 20;
+         bench_result labelling = run_benchmark("labelling", crossover_options, [&]()
+         {
+            std::vector<std::pair<size_t, size_t> > edges;
+            return uint64_t(calculate_steinertree(*boundingbox_lower_bound, instance, settings, edges));
+         });
+         bench_result subset_dp = run_benchmark("subset dp", crossover_options, [&]()
+         {
+            std::vector<std::pair<size_t, size_t> > edges;
+            return uint64_t(calculate_steinertree_dreyfus_wagner(instance, edges));
+         });
+         bench_result sweep = run_benchmark("sweep", crossover_options, [&]()
+         {
+            std::vector<std::pair<size_t, size_t> > edges;
+            return uint64_t(calculate_steinertree_sweep(instance, edges));
+         });
+         if (labelling._checksum != subset_dp._checksum || labelling._checksum != sweep._checksum)
+         {
+            throw std::runtime_error("Engines disagree on crossover instance");
+         }
+         double fastest = std::min(std::min(labelling._median, subset_dp._median), sweep._median);
+         std::cout << "crossover d" << c._dim << " n" << c._side << " k" << num_terminals << ' ' << uint64_t(labelling._median) << ' ' << uint64_t(subset_dp._median) << ' ' << uint64_t(sweep._median) << ' ' << (fastest == labelling._median ? "labelling" : fastest == subset_dp._median ? "subset_dp" : "sweep") << std::endl;
+      }
+   }
+}
+
+/*Labels settled, runtime and excess length of the labelling algorithm with a lower bound weighted by 1 + epsilon*/
+void epsilon_tradeoff(bench_options const & options)
+{
+   struct epsilon_case{terminal_distribution _distribution; size_t _dim; size_t _num_terminals; COOR _range;};
+   epsilon_case const cases[] = {
+      {UNIFORM_TERMINALS, 2, 12, 1000}, {UNIFORM_TERMINALS, 2, 14, 1000}, {CLUSTERED_TERMINALS, 2, 14, 1000},
+      {UNIFORM_TERMINALS, 3, 8, 100}, {UNIFORM_TERMINALS, 3, 10, 100}};
+   double const epsilons[] = {0, 0.01, 0.02, 0.05, 0.1, 0.2};
+   bench_options epsilon_options(options);
+   epsilon_options._min_seconds = options._min_seconds / 10;
+   std::cout << "epsilon <instance> <epsilon> <labels extracted> <ns> <length> <excess>" << std::endl;
+   for (epsilon_case const & c : cases)
+   {
+      std::stringstream name;
+      name << terminal_distribution_name(c._distribution) << "/d" << c._dim << "/k" << c._num_terminals;
+      std::vector<std::vector<COOR> > terminals;
+      generate_terminals(c._distribution, c._dim, c._num_terminals, c._range, c._num_terminals * 31 + c._dim, terminals);
+      steiner_instance instance;
+      create_hanan_instance(terminals, instance);
+      DISTANCE_T optimum = 0;
+      for (double epsilon : epsilons)
+      {
+         dijkstra_steiner_settings settings;
+         settings._maximum_heap_width = 20;
+         settings._epsilon = epsilon;
+         dijkstra_steiner_bounds bounds;
+         settings._bounds = &bounds;
+         bench_result result = run_benchmark(name.str(), epsilon_options, [&]()
+         {
+            std::vector<std::pair<size_t, size_t> > edges;
+            return uint64_t(calculate_steinertree(*boundingbox_lower_bound, instance, settings, edges));
+         });
+         DISTANCE_T length = result._checksum;
+         if (epsilon == 0)
+         {
+            optimum = length;
+         }
+         else if (length > optimum * (1 + epsilon))
+         {
+            throw std::runtime_error("Weighted search exceeds its bound on " + name.str());
+         }
+         std::cout << "epsilon " << name.str() << ' ' << epsilon << ' ' << bounds._labels_extracted << ' ' << uint64_t(result._median) << ' ' << length << ' ' << double(length) / optimum - 1 << std::endl;
+      }
+   }
+}
+
+/*Compares the default knobs with the autotuned ones, with the small subset bound and with the root extracting the fewest labels, the data behind the rules in autotune.cpp*/
+void autotune_report(bench_options const & options)
+{
+   struct autotune_case{size_t _dim; size_t _num_terminals; COOR _range;};
+   autotune_case const cases[] = {{2, 6, 1000}, {2, 8, 1000}, {2, 10, 1000}, {3, 6, 100}, {3, 8, 100}, {3, 10, 100}, {4, 6, 100}, {4, 8, 100}};
+   terminal_distribution const distributions[] = {UNIFORM_TERMINALS, CLUSTERED_TERMINALS};
+   bench_options autotune_options(options);
+   autotune_options._min_seconds = options._min_seconds / 10;
+   double default_log_ratio = 0;
+   double root_log_ratio = 0;
+   double subset_log_ratio = 0;
+   size_t num_instances = 0;
+   std::cout << "autotune <instance> <default ns> <tuned ns> <tuned with small subset bound ns> <default labels> <tuned labels> <fewest labels of any root>" << std::endl;
+   for (terminal_distribution distribution : distributions)
+   {
+      for (autotune_case const & c : cases)
+      {
+         for (size_t seed = 0; seed < 3; ++seed)
+         {
+            std::stringstream name;
+            name << terminal_distribution_name(distribution) << "/d" << c._dim << "/k" << c._num_terminals << "/s" << seed;
+            std::vector<std::vector<COOR> > terminals;
+            generate_terminals(distribution, c._dim, c._num_terminals, c._range, seed * 100 + c._num_terminals, terminals);
+            dijkstra_steiner_settings settings;
+            settings._maximum_heap_width = 20;
+            settings._full_steiner_tree_threshold = std::numeric_limits<size_t>::max();
+            dijkstra_steiner_bounds bounds;
+            settings._bounds = &bounds;
+            DISTANCE_T (*lower_bound)(BITSET terminal_key, size_t vertex, steiner_instance const &) = boundingbox_lower_bound;
+            auto solve = [&]()
+            {
+               std::vector<std::vector<COOR> > steinerpoints;
+               std::vector<std::pair<size_t, size_t> > edges;
+               return uint64_t(calculate_steinertree(*lower_bound, terminals, settings, steinerpoints, edges));
+            };
+            bench_result default_result = run_benchmark(name.str(), autotune_options, solve);
+            size_t default_labels = bounds._labels_extracted;
+            settings._autotune = true;
+            bench_result tuned_result = run_benchmark(name.str(), autotune_options, solve);
+            size_t tuned_labels = bounds._labels_extracted;
+            if (tuned_result._checksum != default_result._checksum)
+            {
+               throw std::runtime_error("Autotuned solve differs on " + name.str());
+            }
+            lower_bound = small_subset_lower_bound;
+            bench_result subset_result = run_benchmark(name.str(), autotune_options, solve);
+            lower_bound = boundingbox_lower_bound;
+            if (subset_result._checksum != default_result._checksum)
+            {
+               throw std::runtime_error("Solve with the small subset bound differs on " + name.str());
+            }
+            settings._autotune = false;
+            size_t fewest_labels = std::numeric_limits<size_t>::max();
+            for (size_t root = 0; root < terminals.size(); ++root)
+            {
+               std::swap(terminals[root], terminals.back());
+               solve();
+               fewest_labels = std::min(fewest_labels, bounds._labels_extracted);
+               std::swap(terminals[root], terminals.back());
+            }
+            default_log_ratio += std::log(tuned_result._median / default_result._median);
+            subset_log_ratio += std::log(subset_result._median / tuned_result._median);
+            root_log_ratio += std::log(double(tuned_labels) / fewest_labels);
+            ++num_instances;
+            std::cout << "autotune " << name.str() << ' ' << uint64_t(default_result._median) << ' ' << uint64_t(tuned_result._median) << ' ' << uint64_t(subset_result._median) << ' ' << default_labels << ' ' << tuned_labels << ' ' << fewest_labels << std::endl;
+         }
+      }
+   }
+   std::cout << "autotune time relative to default " << std::exp(default_log_ratio / num_instances) << ", labels relative to the best root " << std::exp(root_log_ratio / num_instances) << ", time of the small subset bound relative to the bounding box bound " << std::exp(subset_log_ratio / num_instances) << std::endl;
+}
+
+/*Fits the estimator model on half of the seeds and reports its error on the other half, then prints the model fitted on all of them for the estimator_model constructor*/
+void calibrate(bench_options const & options)
+{
+   struct calibration_case{size_t _dim; size_t _num_terminals; COOR _range;};
+   calibration_case const cases[] = {{2, 10, 1000}, {2, 12, 1000}, {2, 14, 1000}, {3, 9, 100}, {3, 11, 100}, {3, 12, 100}, {4, 8, 100}, {4, 9, 100}};
+   terminal_distribution const distributions[] = {UNIFORM_TERMINALS, CLUSTERED_TERMINALS};
+   size_t const sample_labels = 500;
+   size_t const num_seeds = 4;
+   std::vector<estimator_features> features[2];
+   std::vector<estimator_prediction> measured[2];
+   std::cout << "calibrate <instance> <vertices> <lower bound> <upper bound> <sample labels> <sample lower bound> <labels> <seconds> <peak bytes>" << std::endl;
+   for (terminal_distribution distribution : distributions)
+   {
+      for (calibration_case const & c : cases)
+      {
+         for (size_t seed = 0; seed < num_seeds; ++seed)
+         {
+            std::stringstream name;
+            name << terminal_distribution_name(distribution) << "/d" << c._dim << "/k" << c._num_terminals << "/s" << seed;
+            if (name.str().find(options._filter) == std::string::npos)
+            {
+               continue;
+            }
+            std::vector<std::vector<COOR> > terminals;
+            generate_terminals(distribution, c._dim, c._num_terminals, c._range, seed * 100 + c._num_terminals + 7, terminals);
+            steiner_instance instance;
+            create_hanan_instance(terminals, instance);
+            dijkstra_steiner_settings settings;
+            settings._maximum_heap_width = 20;
+            dijkstra_steiner_bounds bounds;
+            dijkstra_steiner_memory_usage memory_usage;
+            settings._bounds = &bounds;
+            settings._memory_usage = &memory_usage;
+
+            estimator_features f;
+            compute_estimator_features(*boundingbox_lower_bound, instance, settings, sample_labels, f);
+            std::vector<std::pair<size_t, size_t> > edges;
+            auto begin = std::chrono::steady_clock::now();
+            calculate_steinertree(*boundingbox_lower_bound, instance, settings, edges);
+            estimator_prediction m;
+            m._seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+            m._labels = bounds._labels_extracted;
+            m._peak_bytes = memory_usage._peak_bytes;
+            features[seed % 2].push_back(f);
+            measured[seed % 2].push_back(m);
+            std::cout << "calibrate " << name.str() << ' ' << f._num_vertices << ' ' << f._lower_bound << ' ' << f._upper_bound << ' ' << f._sample_labels << ' ' << f._sample_lower_bound << ' ' << m._labels << ' ' << m._seconds << ' ' << m._peak_bytes << std::endl;
+         }
+      }
+   }
+   estimator_model model;
+   fit_estimator_model(features[0], measured[0], model);
+   std::vector<double> label_errors;
+   std::vector<double> seconds_errors;
+   std::vector<double> bytes_errors;
+   for (size_t i = 0; i < features[1].size(); ++i)
+   {
+      if (features[1][i]._sample_finished)
+      {
+         continue;
+      }
+      estimator_prediction p;
+      estimate_resources(features[1][i], model, p);
+      label_errors.push_back(std::abs(std::log(p._labels / measured[1][i]._labels)));
+      seconds_errors.push_back(std::abs(std::log(p._seconds / measured[1][i]._seconds)));
+      bytes_errors.push_back(std::abs(std::log(p._peak_bytes / measured[1][i]._peak_bytes)));
+   }
+   if (!label_errors.empty())
+   {
+      auto median_factor = [](std::vector<double> & errors)
+      {
+         std::sort(errors.begin(), errors.end());
+         return std::exp(errors[errors.size() / 2]);
+      };
+      std::cout << "held out searches " << label_errors.size() << ", median error factor labels " << median_factor(label_errors) << " seconds " << median_factor(seconds_errors) << " bytes " << median_factor(bytes_errors) << std::endl;
+   }
+   features[0].insert(features[0].end(), features[1].begin(), features[1].end());
+   measured[0].insert(measured[0].end(), measured[1].begin(), measured[1].end());
+   fit_estimator_model(features[0], measured[0], model);
+   std::cout << "model _label_coefficients{";
+   for (size_t i = 0; i < 5; ++i)
+   {
+      std::cout << (i == 0 ? "" : ", ") << model._label_coefficients[i];
+   }
+   std::cout << "}, _seconds_factor(" << model._seconds_factor << "), _bytes_per_label(" << model._bytes_per_label << ')' << std::endl;
+}
+
+/*Reports benchmarks slower than the baseline by more than the tolerance or with a different checksum*/
+size_t compare_baseline(bench_options const & options, std::vector<bench_result> const & results)
+{
+   std::ifstream file(options._baseline);
+   if (!file.good())
+   {
+      throw std::runtime_error("Can't open baseline " + options._baseline);
+   }
+   std::map<std::string, bench_result> baseline;
+   std::string line;
+   while (std::getline(file, line))
+   {
+      std::stringstream ss(line);
+      bench_result result;
+      if (ss >> result._name >> result._repetitions >> result._median >> result._min >> result._checksum)
+      {
+         baseline[result._name] = result;
+      }
+   }
+   size_t num_regressions = 0;
+   for (bench_result const & result : results)
+   {
+      auto iter = baseline.find(result._name);
+      if (iter == baseline.end())
+      {
+         continue;
+      }
+      double ratio = result._median / iter->second._median;
+      if (result._checksum != iter->second._checksum)
+      {
+         std::cerr << "CHECKSUM " << result._name << ' ' << iter->second._checksum << " -> " << result._checksum << std::endl;
+         ++num_regressions;
+      }
+      else if (ratio > 1 + options._tolerance)
+      {
+         std::cerr << "SLOWER " << result._name << " x" << ratio << std::endl;
+         ++num_regressions;
+      }
+      else if (ratio < 1 - options._tolerance)
+      {
+         std::cerr << "FASTER " << result._name << " x" << ratio << std::endl;
+      }
+   }
+   return num_regressions;
+}
+
+int main(int argc, const char *argv[])
+{
+   bench_options options;
+   for (int i = 1; i < argc; ++i)
+   {
+      std::string arg = argv[i];
+      if (arg == "--filter" && i + 1 < argc)
+      {
+         options._filter = argv[++i];
+      }
+      else if (arg == "--baseline" && i + 1 < argc)
+      {
+         options._baseline = argv[++i];
+      }
+      else if (arg == "--min-time" && i + 1 < argc)
+      {
+         options._min_seconds = std::atof(argv[++i]);
+      }
+      else if (arg == "--tolerance" && i + 1 < argc)
+      {
+         options._tolerance = std::atof(argv[++i]);
+      }
+      else if (arg == "--fuzz" && i + 1 < argc)
+      {
+         options._fuzz_instances = std::atoi(argv[++i]);
+      }
+      else if (arg == "--crossover")
+      {
+         options._crossover = true;
+      }
+      else if (arg == "--epsilon")
+      {
+         options._epsilon = true;
+      }
+      else if (arg == "--autotune")
+      {
+         options._autotune = true;
+      }
+      else if (arg == "--calibrate")
+      {
+         options._calibrate = true;
+      }
+      else
+      {
+         std::cout << "benchmark [--filter <substring>] [--min-time <seconds>] [--baseline <file>] [--tolerance <fraction>] [--fuzz <instances>] [--crossover] [--epsilon] [--autotune] [--calibrate]" << std::endl;
+         return 0;
+      }
+   }
+   if (options._fuzz_instances != 0)
+   {
+      return fuzz(options) == 0 ? 0 : 1;
+   }
+   if (options._crossover)
+   {
+      crossover(options);
+      return 0;
+   }
+   if (options._epsilon)
+   {
+      epsilon_tradeoff(options);
+      return 0;
+   }
+   if (options._autotune)
+   {
+      autotune_report(options);
+      return 0;
+   }
+   if (options._calibrate)
+   {
+      calibrate(options);
+      return 0;
+   }
+   std::vector<bench_result> results;
+   micro_benchmarks(options, results);
+   solver_benchmarks(options, results);
+   if (!options._baseline.empty() && compare_baseline(options, results) != 0)
+   {
+      return 1;
+   }
+   return 0;
+}
@@ -26,6 +26,8 @@
 
 #include <exception>
 #include <algorithm>
+#include <vector>
+#include <utility>
 #include "util.h"
 
 template <class Item>
@@ -41,10 +43,33 @@ public:
 
    Item* get_element(BITSET key);
 
+   void erase_element(BITSET key);
+
+   template <typename Function>
+   void for_each(Function function);
+
+   /*Rebuilds the trie with layers of the given number of bits, keeping all elements*/
+   void set_chunk_size(size_t chunk_size_);
+
+   size_t memory_usage() const{return _memory_usage;}
+
+   size_t num_layers() const;
+
+   static size_t root_memory_usage(size_t num_bits_, size_t chunk_size_);
+
    void delete_node_rek(void *node, size_t depth);
 
    ~BitSetMap();
 private:
+   void init(size_t num_bits_, size_t chunk_size_);
+
+   void** new_layer(size_t size);
+
+   template <typename Function>
+   void for_each_rek(void *node, size_t depth, BITSET prefix, Function & function);
+
+   size_t num_layers_rek(void *node, size_t depth) const;
+
    size_t _total_bits;
    size_t _layer_count;
    size_t _layer_size;
@@ -52,6 +77,7 @@ private:
    size_t _first_layer_size;
    size_t _first_layer_bits;
    size_t _bitmask;
+   size_t _memory_usage;
    void *_root;
 };
 
@@ -65,22 +91,46 @@ BitSetMap<Item>::BitSetMap(BitSetMap<Item> const & btm_)
    _bitmask = btm_._bitmask;
    _first_layer_bits = btm_._first_layer_bits;
    _first_layer_size = btm_._first_layer_size;
-   _root = new void*[_first_layer_size];
-   std::fill((void**)_root, ((void**)_root) + _first_layer_size, nullptr);
+   _memory_usage = 0;
+   _root = new_layer(_first_layer_size);
 }
 
 template <class Item>
 BitSetMap<Item>::BitSetMap(size_t num_bits_, size_t chunk_size_)
 {
-   _layer_bits = chunk_size_;
+   init(num_bits_, chunk_size_);
+}
+
+template <class Item>
+void BitSetMap<Item>::init(size_t num_bits_, size_t chunk_size_)
+{
+   /*Layers wider than the key would only waste memory, and shifts by 64 bits are undefined*/
+   _layer_bits = std::max(std::min(chunk_size_, num_bits_), size_t(1));
    _total_bits = num_bits_;
    _layer_count = (num_bits_ + _layer_bits - 1) / _layer_bits;
-   _layer_size = 1 << _layer_bits;
+   _layer_size = size_t(1) << _layer_bits;
    _bitmask = _layer_size - 1;
    _first_layer_bits = num_bits_ - (_layer_bits * (std::max(_layer_count, 1lu) - 1));
-   _first_layer_size = 1 << _first_layer_bits;
-   _root = new void*[_first_layer_size];
-   std::fill((void**)_root, ((void**)_root) + _first_layer_size, nullptr);
+   _first_layer_size = size_t(1) << _first_layer_bits;
+   _memory_usage = 0;
+   _root = new_layer(_first_layer_size);
+}
+
+template <class Item>
+void** BitSetMap<Item>::new_layer(size_t size)
+{
+   void **layer = new void*[size];
+   std::fill(layer, layer + size, nullptr);
+   _memory_usage += size * sizeof(void*);
+   return layer;
+}
+
+template <class Item>
+size_t BitSetMap<Item>::root_memory_usage(size_t num_bits_, size_t chunk_size_)
+{
+   chunk_size_ = std::max(std::min(chunk_size_, num_bits_), size_t(1));
+   size_t layer_count = (num_bits_ + chunk_size_ - 1) / chunk_size_;
+   return (size_t(1) << (num_bits_ - (chunk_size_ * (std::max(layer_count, 1lu) - 1)))) * sizeof(void*);
 }
 
 template <class Item>
@@ -91,8 +141,7 @@ Item* BitSetMap<Item>::get_or_insert(BITSET key, Item & data)
    {
       if (*current_node == nullptr)
       {
-         *current_node = new void*[_layer_size];
-         std::fill((void**)*current_node, (void**)(*current_node) + _layer_size, nullptr);
+         *current_node = new_layer(_layer_size);
       }
       size_t index = (key >> i) & _bitmask;
       current_node = ((void**)(*current_node)) + index;
@@ -118,8 +167,7 @@ void BitSetMap<Item>::insert_element(BITSET key, Item & data)
    {
       if (*current_node == nullptr)
       {
-         *current_node = new void*[_layer_size];
-         std::fill((void**)*current_node, (void**)(*current_node) + _layer_size, nullptr);
+         *current_node = new_layer(_layer_size);
       }
       size_t index = (key >> i) & _bitmask;
       current_node = ((void**)(*current_node)) + index;
@@ -143,6 +191,90 @@ Item* BitSetMap<Item>::get_element(BITSET key)
    return (Item*)current_node;
 }
 
+template <class Item>
+void BitSetMap<Item>::erase_element(BITSET key)
+{
+   void **current_node = &_root;
+   for (int i = (_layer_count - 1) * _layer_bits; i >= 0; i -= _layer_bits)
+   {
+      if (*current_node == nullptr)
+      {
+         return;
+      }
+      size_t index = (key >> i) & _bitmask;
+      current_node = ((void**)(*current_node)) + index;
+   }
+   *current_node = nullptr;
+}
+
+template <class Item>
+template <typename Function>
+void BitSetMap<Item>::for_each(Function function)
+{
+   if (_layer_count != 0)
+   {
+      for_each_rek(_root, 1, 0, function);
+   }
+}
+
+template <class Item>
+template <typename Function>
+void BitSetMap<Item>::for_each_rek(void *node, size_t depth, BITSET prefix, Function & function)
+{
+   for (size_t i = 0; i < (depth == 1 ? _first_layer_size : _layer_size); ++i)
+   {
+      void *child = ((void **)node)[i];
+      if (child != nullptr)
+      {
+         BITSET key = (prefix << _layer_bits) | i;
+         if (depth == _layer_count)
+         {
+            function(key, *(Item*)child);
+         }
+         else
+         {
+            for_each_rek(child, depth + 1, key, function);
+         }
+      }
+   }
+}
+
+template <class Item>
+size_t BitSetMap<Item>::num_layers() const
+{
+   return _root == nullptr ? 0 : num_layers_rek(_root, 1);
+}
+
+template <class Item>
+size_t BitSetMap<Item>::num_layers_rek(void *node, size_t depth) const
+{
+   size_t result = 1;
+   if (depth < _layer_count)
+   {
+      for (size_t i = 0; i < (depth == 1 ? _first_layer_size : _layer_size); ++i)
+      {
+         if (((void **)node)[i] != nullptr)
+         {
+            result += num_layers_rek(((void **)node)[i], depth + 1);
+         }
+      }
+   }
+   return result;
+}
+
+template <class Item>
+void BitSetMap<Item>::set_chunk_size(size_t chunk_size_)
+{
+   std::vector<std::pair<BITSET, Item*> > elements;
+   for_each([&elements](BITSET key, Item & data){elements.emplace_back(key, &data);});
+   delete_node_rek(_root, 1);
+   init(_total_bits, chunk_size_);
+   for (std::pair<BITSET, Item*> const & element : elements)
+   {
+      insert_element(element.first, *element.second);
+   }
+}
+
 template <class Item>
 void BitSetMap<Item>::delete_node_rek(void *node, size_t depth)
 {
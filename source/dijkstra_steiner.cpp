@@ -26,13 +26,32 @@
 #include <exception>
 #include <limits>
 #include <cstdint>
+#include <cstdlib>
 #include <iterator>
 #include <numeric>
+#include <memory>
+#include <queue>
+#include <chrono>
+#include <new>
 #include "heap.h"
 #include "bitset_map.h"
 #include "util.h"
 #include "dijkstra_steiner.h"
 #include "instance_io.h"
+#include "full_steiner_tree.h"
+#include "spill_file.h"
+#include "phase_trace.h"
+#include "sweep_steiner.h"
+#include "heuristic_steiner.h"
+#include "autotune.h"
+#include "portfolio.h"
+#include "distributed_steiner.h"
+
+#ifdef DIJKSTRA_STEINER_STATISTICS
+#define STATISTICS(x) x
+#else
+#define STATISTICS(x)
+#endif
 
 struct node_comparator_struct
 {
@@ -172,33 +191,121 @@ void mark_excluded_vertices(std::vector<std::vector<size_t > > const & terminals
       }
       default:
       {
-         /*Project to all 2d-surfaces*/
-         std::vector<std::vector<size_t> > terminals_plane(terminals.size(), std::vector<size_t>(2, 0));
-        std::vector<size_t> sizes_plane(2);
-        std::vector<size_t> indices(dim, 0);
-        std::vector<bool> is_excluded_plane;
+         /*Project to all 2d-surfaces, the surfaces are independent and processed in parallel*/
+         std::vector<std::pair<size_t, size_t> > planes;
          for (size_t i = 1; i < dim; ++i)
          {
-            sizes_plane[0] = sizes[i];
             for (size_t j = 0; j < i; ++j)
             {
-               sizes_plane[1] = sizes[j];
-               is_excluded_plane.resize(sizes_plane[0] * sizes_plane[1], false);
-               for (size_t k = 0; k < terminals.size(); ++k)
+               planes.emplace_back(i, j);
+            }
+         }
+         std::vector<std::vector<bool> > is_excluded_planes(planes.size());
+         std::exception_ptr exception;
+         #pragma omp parallel for schedule(dynamic)
+         for (size_t p = 0; p < planes.size(); ++p)
+         {
+            try
+            {
+               size_t i = planes[p].first;
+               size_t j = planes[p].second;
+               std::vector<std::vector<size_t> > terminals_plane;
+               terminals_plane.reserve(terminals.size());
+               for (std::vector<size_t> const & t : terminals)
                {
-                  terminals_plane[k] = {terminals[k][i], terminals[k][j]};
+                  terminals_plane.push_back({t[i], t[j]});
                }
-               mark_excluded_vertices(terminals_plane, sizes_plane, is_excluded_plane);
-               std::fill(indices.begin(), indices.end(), 0);
-               for (size_t index = 0; indices.back() < sizes.back(); ++index)
+               mark_excluded_vertices(terminals_plane, {sizes[i], sizes[j]}, is_excluded_planes[p]);
+            }
+            catch (...)
+            {
+               #pragma omp critical
+               exception = std::current_exception();
+            }
+         }
+         if (exception)
+         {
+            std::rethrow_exception(exception);
+         }
+
+         /*Surfaces containing the first axis exclude parts of a row, all others exclude whole rows*/
+         size_t row_size = sizes[0];
+         size_t row_words = (row_size + 63) / 64;
+         size_t num_rows = size / row_size;
+         std::vector<std::vector<uint64_t> > axis_rows(dim);
+         for (size_t p = 0; p < planes.size(); ++p)
+         {
+            if (planes[p].second == 0)
+            {
+               size_t i = planes[p].first;
+               std::vector<bool> const & is_excluded_plane = is_excluded_planes[p];
+               axis_rows[i].resize(sizes[i] * row_words, 0);
+               for (size_t k = 0; k < sizes[i]; ++k)
                {
-                  if (is_excluded_plane[indices[i] + sizes_plane[0] * indices[j]])
+                  uint64_t *row = &axis_rows[i][k * row_words];
+                  for (size_t l = 0; l < row_size; ++l)
                   {
-                     is_excluded[index] = true;
+                     if (is_excluded_plane[k + sizes[i] * l])
+                     {
+                        row[l / 64] |= uint64_t(1) << (l % 64);
+                     }
+                  }
+               }
+            }
+         }
+
+         /*Rows are padded to whole words, so they can be written concurrently*/
+         std::vector<size_t> sizes_rows(sizes.begin() + 1, sizes.end());
+         std::vector<uint64_t> is_excluded_packed(num_rows * row_words, 0);
+         #pragma omp parallel
+         {
+            std::vector<size_t> indices;
+            #pragma omp for schedule(static)
+            for (size_t r = 0; r < num_rows; ++r)
+            {
+               calculate_position(sizes_rows, indices, r);
+               uint64_t *row = &is_excluded_packed[r * row_words];
+               bool row_excluded = false;
+               for (size_t p = 0; p < planes.size() && !row_excluded; ++p)
+               {
+                  size_t i = planes[p].first;
+                  size_t j = planes[p].second;
+                  row_excluded = j != 0 && is_excluded_planes[p][indices[i - 1] + sizes[i] * indices[j - 1]];
+               }
+               if (row_excluded)
+               {
+                  std::fill(row, row + row_words, ~uint64_t(0));
+                  continue;
+               }
+               for (size_t i = 1; i < dim; ++i)
+               {
+                  uint64_t const *axis_row = &axis_rows[i][indices[i - 1] * row_words];
+                  for (size_t w = 0; w < row_words; ++w)
+                  {
+                     row[w] |= axis_row[w];
+                  }
+               }
+            }
+         }
+         for (size_t r = 0; r < num_rows; ++r)
+         {
+            uint64_t const *row = &is_excluded_packed[r * row_words];
+            auto iter = is_excluded.begin() + r * row_size;
+            for (size_t w = 0; w < row_words; ++w)
+            {
+               size_t begin = w * 64;
+               size_t end = std::min(begin + 64, row_size);
+               if (row[w] == ~uint64_t(0))
+               {
+                  std::fill(iter + begin, iter + end, true);
+               }
+               else if (row[w] != 0)
+               {
+                  for (size_t l = begin; l < end; ++l)
+                  {
+                     iter[l] = (row[w] >> (l % 64)) & 1;
                   }
-                  increment(indices, sizes);
                }
-               is_excluded_plane.clear();
             }
          }
          break;
@@ -221,6 +328,7 @@ void mark_excluded_vertices(steiner_instance & instance)
 {
    std::vector<bool> is_excluded;
    mark_excluded_vertices(instance._terminals, instance._sizes, is_excluded);
+   #pragma omp parallel for schedule(static)
    for (size_t i = 0; i < instance._vertices.size(); ++i)
    {
       if (is_excluded[i])
@@ -270,15 +378,9 @@ void mark_excluded_vertices(steiner_instance & instance)
    }
 }*/
 
-DISTANCE_T calculate_steinertree(
-   DISTANCE_T (*lower_bound)(BITSET terminal_key, size_t vertex, steiner_instance const &),
-   std::vector<std::vector <COOR> > const & terminals,
-   dijkstra_steiner_settings const & settings,
-   std::vector<std::vector <COOR> > & steinerpoints,
-   std::vector<std::pair<size_t, size_t> > & edges)
+void create_hanan_instance(std::vector<std::vector <COOR> > const & terminals, steiner_instance & instance, PhaseTrace *trace)
 {
-   steinerpoints.clear();
-   edges.clear();
+   ScopedPhase phase(trace, "axis compression");
    size_t dim = terminals[0].size();
    std::vector<std::vector<COOR> > coords(dim);
    for (size_t j = 0; j < dim; ++j)
@@ -311,26 +413,14 @@ DISTANCE_T calculate_steinertree(
       }
    }
    std::vector<bool> excluded;
+   phase.next("mark_excluded_vertices");
    mark_excluded_vertices(terminal_indizes, sizes, excluded);
-   steiner_instance instance;
-   instance._sizes = sizes;
-   instance._vertices.reserve(std::accumulate(instance._sizes.begin(), instance._sizes.end(), size_t(1), std::multiplies<size_t>()));
-
-   std::vector<size_t> indices(dim, 0);
-   size_t index = 0;
-   while (indices.back() < instance._sizes.back())
+   phase.next("instance construction");
+   create_grid_vertices(coords, instance);
+   #pragma omp parallel for schedule(static)
+   for (size_t i = 0; i < instance._vertices.size(); ++i)
    {
-      instance._vertices.push_back(vertex());
-      vertex & current_v = instance._vertices.back();
-      current_v._coords.reserve(dim);
-      for (size_t i = 0; i < dim; ++i)
-      {
-         current_v._coords.push_back(coords[i][indices[i]]);
-      }
-      current_v._is_excluded = excluded[index];
-      current_v._terminal_number = std::numeric_limits<uint8_t>::max();
-      increment(indices, instance._sizes);
-      ++index;
+      instance._vertices[i]._is_excluded = excluded[i];
    }
 
    instance._terminals.reserve(terminals.size());
@@ -342,83 +432,188 @@ DISTANCE_T calculate_steinertree(
       instance._terminals.push_back(index);
       instance._terminal_coords.insert(instance._terminal_coords.end(), instance._vertices[index]._coords.begin(), instance._vertices[index]._coords.end());
    }
-   mark_excluded_vertices(instance);
+   phase.next("update_neighbours");
    update_neighbours(instance);
-   std::vector<std::pair<size_t, size_t> > grid_edges;
-   //print_instance(instance);
-   DISTANCE_T length = calculate_steinertree(lower_bound, instance, settings, grid_edges);
-   std::vector<std::vector<size_t> > adjactend_nodes(instance._vertices.size(), std::vector<size_t>());
+}
+
+void compress_steinertree(
+   steiner_instance const & instance,
+   std::vector<std::pair<size_t, size_t> > const & grid_edges,
+   dijkstra_steiner_settings const & settings,
+   std::vector<std::vector <COOR> > & steinerpoints,
+   std::vector<std::pair<size_t, size_t> > & edges)
+{
+   ScopedPhase phase(settings._trace, "compress");
+   steinerpoints.clear();
+   edges.clear();
+   /*Only the vertices of the tree are touched, the neighbours of a vertex are a range of the sorted directed edges*/
+   std::vector<std::pair<size_t, size_t> > adjacency;
+   adjacency.reserve(grid_edges.size() * 2);
    for (auto const & ge : grid_edges)
    {
-      adjactend_nodes[ge.first].push_back(ge.second);
-      adjactend_nodes[ge.second].push_back(ge.first);
+      adjacency.emplace_back(ge.first, ge.second);
+      adjacency.emplace_back(ge.second, ge.first);
    }
-   std::vector<bool> visited(instance._vertices.size(), false);
-   std::vector<size_t> vertex_kind(instance._vertices.size(), std::numeric_limits<size_t>::max());
-   for (size_t i = 0; i < instance._vertices.size(); ++i)
+   std::sort(adjacency.begin(), adjacency.end());
+   std::vector<size_t> tree_vertices;
+   std::vector<size_t> first_neighbour;
+   for (size_t i = 0; i < adjacency.size(); ++i)
    {
-      if (instance._vertices[i]._terminal_number < instance._terminals.size())
+      if (i == 0 || adjacency[i].first != adjacency[i - 1].first)
       {
-         vertex_kind[i] = instance._vertices[i]._terminal_number; /*save this node*/
+         tree_vertices.push_back(adjacency[i].first);
+         first_neighbour.push_back(i);
       }
-      else if (adjactend_nodes[i].size() != 0)
+   }
+   first_neighbour.push_back(adjacency.size());
+   auto local_index = [&tree_vertices](size_t v){return std::lower_bound(tree_vertices.begin(), tree_vertices.end(), v) - tree_vertices.begin();};
+   std::vector<bool> visited(tree_vertices.size(), false);
+   std::vector<size_t> vertex_kind(tree_vertices.size());
+   for (size_t i = 0; i < tree_vertices.size(); ++i)
+   {
+      size_t v = tree_vertices[i];
+      size_t num_neighbours = first_neighbour[i + 1] - first_neighbour[i];
+      std::pair<size_t, size_t> const *neighbours = &adjacency[first_neighbour[i]];
+      if (instance._vertices[v]._terminal_number < instance._terminals.size())
       {
-         if (adjactend_nodes[i].size() != 2
-            || (settings._edge_as_steinerpoint && adjactend_nodes[i][0] + adjactend_nodes[i][1] != i * 2))
-         {
-            vertex_kind[i] = instance._terminals.size() + steinerpoints.size(); /*save this node*/
-            steinerpoints.push_back(instance._vertices[i]._coords);
-         }
-         else
-         {
-            vertex_kind[i] = std::numeric_limits<size_t>::max() - 1; /*node on trunk*/
-         }
+         vertex_kind[i] = instance._vertices[v]._terminal_number; /*save this node*/
+      }
+      else if (num_neighbours != 2
+         || (settings._edge_as_steinerpoint && neighbours[0].second + neighbours[1].second != v * 2))
+      {
+         vertex_kind[i] = instance._terminals.size() + steinerpoints.size(); /*save this node*/
+         steinerpoints.push_back(instance._vertices[v]._coords);
+      }
+      else
+      {
+         vertex_kind[i] = std::numeric_limits<size_t>::max() - 1; /*node on trunk*/
       }
    }
-   for (size_t i = 0; i < instance._vertices.size(); ++i)
+   for (size_t i = 0; i < tree_vertices.size(); ++i)
    {
-      if (vertex_kind[i] < instance._terminals.size() + steinerpoints.size())
+      if (vertex_kind[i] != std::numeric_limits<size_t>::max() - 1)
       {
          visited[i] = true;
-         for (size_t j = 0; j < adjactend_nodes[i].size(); ++j)
+         for (size_t j = first_neighbour[i]; j < first_neighbour[i + 1]; ++j)
          {
-            size_t last_vertex = i;
-            size_t current_vertex = adjactend_nodes[i][j];
-            size_t next_vertex = std::numeric_limits<size_t>::max();
-            if (visited[current_vertex])
+            size_t last_vertex = tree_vertices[i];
+            size_t current_vertex = adjacency[j].second;
+            size_t current_index = local_index(current_vertex);
+            if (visited[current_index])
             {
                continue;
             }
-            while (vertex_kind[current_vertex] == std::numeric_limits<size_t>::max() - 1)
+            while (vertex_kind[current_index] == std::numeric_limits<size_t>::max() - 1)
             {
-               visited[current_vertex] = true;
-               next_vertex = last_vertex ^ adjactend_nodes[current_vertex][1] ^ adjactend_nodes[current_vertex][0];
+               visited[current_index] = true;
+               size_t next_vertex = last_vertex ^ adjacency[first_neighbour[current_index]].second ^ adjacency[first_neighbour[current_index] + 1].second;
                last_vertex = current_vertex;
                current_vertex = next_vertex;
+               current_index = local_index(current_vertex);
             }
-            edges.emplace_back(vertex_kind[i], vertex_kind[current_vertex]);
+            edges.emplace_back(vertex_kind[i], vertex_kind[current_index]);
          }
       }
    }
-   return length;
 }
 
-void track_back(
-   std::vector<std::pair<size_t, size_t> > & edges,
-   light_node const & n)
+DISTANCE_T calculate_steinertree(
+   DISTANCE_T (*lower_bound)(BITSET terminal_key, size_t vertex, steiner_instance const &),
+   std::vector<std::vector <COOR> > const & terminals,
+   dijkstra_steiner_settings const & settings,
+   std::vector<std::vector <COOR> > & steinerpoints,
+   std::vector<std::pair<size_t, size_t> > & edges)
 {
-   if (!n.prev0)
+   size_t heuristic_threshold = terminals[0].size() <= 2 ? settings._heuristic_threshold : settings._heuristic_threshold_high_dim;
+   if (heuristic_threshold != 0 && terminals.size() > heuristic_threshold)
    {
+      return calculate_steinertree_heuristic(lower_bound, terminals, settings, steinerpoints, edges);
    }
-   else if (n.prev0 == n.prev1)
+   if (terminals[0].size() == 2 && terminals.size() > settings._full_steiner_tree_threshold)
    {
-      edges.emplace_back(n._v, n.prev0->_v);
-      track_back(edges, *n.prev0);
+      return calculate_steinertree_full_steiner_trees(terminals, settings, steinerpoints, edges);
+   }
+   if (settings._portfolio_threads > 1 && !settings._dense_sweep)
+   {
+      return calculate_steinertree_portfolio(lower_bound, terminals, settings, steinerpoints, edges);
+   }
+   /*The root of the search is always the last terminal, autotuning may swap another one there*/
+   size_t root = terminals.size() - 1;
+   std::vector<std::vector <COOR> > tuned_terminals;
+   dijkstra_steiner_settings tuned_settings(settings);
+   if (settings._autotune && !settings._dense_sweep)
+   {
+      instance_features features;
+      compute_instance_features(terminals, features);
+      autotune_choice choice;
+      autotune(features, choice);
+      root = choice._root;
+      tuned_terminals = terminals;
+      std::swap(tuned_terminals[root], tuned_terminals.back());
+      tuned_settings._maximum_heap_width = choice._maximum_heap_width;
+   }
+   steiner_instance instance;
+   create_hanan_instance(settings._autotune && !settings._dense_sweep ? tuned_terminals : terminals, instance, settings._trace);
+   std::vector<std::pair<size_t, size_t> > grid_edges;
+   //print_instance(instance);
+   DISTANCE_T length;
+   if (settings._dense_sweep)
+   {
+      ScopedPhase phase(settings._trace, "sweep");
+      length = calculate_steinertree_sweep(instance, grid_edges);
+      if (settings._bounds != nullptr)
+      {
+         settings._bounds->_lower_bound = settings._bounds->_upper_bound = length;
+      }
    }
    else
    {
-      track_back(edges, *n.prev0);
-      track_back(edges, *n.prev1);
+      length = calculate_steinertree(lower_bound, instance, tuned_settings, grid_edges);
+   }
+   compress_steinertree(instance, grid_edges, settings, steinerpoints, edges);
+   if (root != terminals.size() - 1)
+   {
+      for (std::pair<size_t, size_t> & e : edges)
+      {
+         for (size_t *index : {&e.first, &e.second})
+         {
+            if (*index == root)
+            {
+               *index = terminals.size() - 1;
+            }
+            else if (*index == terminals.size() - 1)
+            {
+               *index = root;
+            }
+         }
+      }
+   }
+   return length;
+}
+
+/*Collects the edges of the tree of a label, with an explicit stack since paths through the grid can be arbitrarily long*/
+void track_back(
+   std::vector<std::pair<size_t, size_t> > & edges,
+   light_node const & root)
+{
+   std::vector<light_node const *> stack(1, &root);
+   while (!stack.empty())
+   {
+      light_node const & n = *stack.back();
+      stack.pop_back();
+      if (!n.prev0)
+      {
+      }
+      else if (n.prev0 == n.prev1)
+      {
+         edges.emplace_back(n._v, n.prev0->_v);
+         stack.push_back(n.prev0);
+      }
+      else
+      {
+         stack.push_back(n.prev1);
+         stack.push_back(n.prev0);
+      }
    }
 }
 
@@ -431,161 +626,828 @@ struct extracted_node_t
     extracted_node_t(light_node *node_, BITSET key_, DISTANCE_T dist_) : _node(node_), _key(key_), _dist(dist_){}
 };
 
-DISTANCE_T calculate_steinertree(
-   DISTANCE_T (*lower_bound)(BITSET terminal_key, size_t vertex, steiner_instance const &),
+/*Permanent label in a spill file*/
+struct spilled_label : light_node
+{
+   BITSET _terminal_key;
+};
+
+/*Header of a run of permanent labels of one vertex and terminal count in a spill file, the labels follow it. A merge scans
+whole blocks instead of chasing single labels, the blocks of a vertex grow geometrically so that few labels waste little*/
+struct spill_block
+{
+   spill_block *_next;                     /*block with the earlier labels of the same vertex and terminal count*/
+   uint32_t _size;
+   uint32_t _capacity;
+
+   spilled_label *labels(){return reinterpret_cast<spilled_label*>(this + 1);}
+};
+
+/*Permanent label of a vertex which is not dominated by another one with more terminals and no greater steinerlength*/
+struct dominance_entry
+{
+   BITSET _key;
+   DISTANCE_T _steinerlength;
+   uint8_t _terminal_count;
+
+   dominance_entry(BITSET key_, DISTANCE_T steinerlength_) : _key(key_), _steinerlength(steinerlength_), _terminal_count(__builtin_popcountll(key_)){}
+};
+
+/*Labels of one vertex, allocated when the vertex is reached for the first time*/
+struct vertex_labels
+{
+   BitSetMap<light_node> _tree;
+   /*Permanent labels by terminal count, in memory or in the spill files*/
+   std::vector<std::vector<extracted_node_t> > _extracted;
+   std::vector<spill_block*> _spilled;
+   /*Undominated permanent labels by descending terminal count, every dominated permanent label is dominated by one of them*/
+   std::vector<dominance_entry> _front;
+
+   vertex_labels(size_t num_keyed_terminals, size_t trie_width, bool out_of_core_mode) :
+      _tree(num_keyed_terminals, trie_width),
+      _extracted(out_of_core_mode ? 0 : num_keyed_terminals + 1),
+      _spilled(out_of_core_mode ? num_keyed_terminals + 1 : 0, nullptr){}
+};
+
+/*Address range reserved for a spill file without a memory budget, only the used part is backed by the file*/
+static const size_t spill_reserved_bytes = size_t(1) << 32;
+/*With a memory budget the reserved address range is the budget rounded up to a multiple of this*/
+static const size_t spill_reserved_step_bytes = size_t(1) << 20;
+static const uint32_t spill_block_min_labels = 4;
+static const uint32_t spill_block_max_labels = 256;
+
+/*Fractions of the memory budget in percent at which the next cheaper representation is chosen*/
+static const size_t memory_escalation_percent[] = {50, 75, 90};
+
+DISTANCE_T terminal_spanning_tree_length(steiner_instance const & instance)
+{
+   size_t num_terminals = instance._terminals.size();
+   std::vector<DISTANCE_T> distance(num_terminals, std::numeric_limits<DISTANCE_T>::max());
+   std::vector<bool> connected(num_terminals, false);
+   DISTANCE_T length = 0;
+   distance[0] = 0;
+   for (size_t i = 0; i < num_terminals; ++i)
+   {
+      size_t next = std::numeric_limits<size_t>::max();
+      for (size_t j = 0; j < num_terminals; ++j)
+      {
+         if (!connected[j] && (next == std::numeric_limits<size_t>::max() || distance[j] < distance[next]))
+         {
+            next = j;
+         }
+      }
+      connected[next] = true;
+      length += distance[next];
+      std::vector<COOR> const & next_coords = instance._vertices[instance._terminals[next]]._coords;
+      for (size_t j = 0; j < num_terminals; ++j)
+      {
+         std::vector<COOR> const & coords = instance._vertices[instance._terminals[j]]._coords;
+         DISTANCE_T d = 0;
+         for (size_t k = 0; k < coords.size(); ++k)
+         {
+            d += std::abs(coords[k] - next_coords[k]);
+         }
+         distance[j] = std::min(distance[j], d);
+      }
+   }
+   return length;
+}
+
+DISTANCE_T terminal_extent(std::vector<std::vector<COOR> > const & terminals)
+{
+   DISTANCE_T extent = 0;
+   for (size_t a = 0; a < terminals[0].size(); ++a)
+   {
+      auto minmax = std::minmax_element(terminals.begin(), terminals.end(), [a](std::vector<COOR> const & lhs, std::vector<COOR> const & rhs){return lhs[a] < rhs[a];});
+      extent += (*minmax.second)[a] - (*minmax.first)[a];
+   }
+   return extent;
+}
+
+DISTANCE_T connect_terminals(
    steiner_instance const & instance,
-   dijkstra_steiner_settings const & settings, 
+   std::vector<bool> & in_tree,
    std::vector<std::pair<size_t, size_t> > & edges)
 {
-   bool small_memory_mode = settings._small_memory_mode;
-
+   typedef std::pair<DISTANCE_T, size_t> queue_entry;
    size_t num_vertices = instance._vertices.size();
-   size_t num_terminals = instance._terminals.size();
-   std::vector<vertex>::const_iterator vertices = instance._vertices.begin();
-   std::vector<node*> node_heap;
-   std::vector<std::vector <extracted_node_t> > extracted(num_vertices * num_terminals);
-   std::vector<BitSetMap<light_node> > node_tree;
-   node_tree.reserve(num_vertices);
-   node_heap.reserve(num_terminals);
-   for (size_t i = 0; i < num_vertices; ++i)
+   std::vector<DISTANCE_T> distance(num_vertices);
+   std::vector<size_t> predecessor(num_vertices);
+   DISTANCE_T length = 0;
+   while (std::any_of(instance._terminals.begin(), instance._terminals.end(), [&in_tree](size_t t){return !in_tree[t];}))
    {
-      node_tree.emplace_back(vertices[i]._is_excluded ? 0 : (num_terminals - 1), settings._maximum_heap_width);
+      std::fill(distance.begin(), distance.end(), std::numeric_limits<DISTANCE_T>::max());
+      std::priority_queue<queue_entry, std::vector<queue_entry>, std::greater<queue_entry> > queue;
+      for (size_t i = 0; i < num_vertices; ++i)
+      {
+         if (in_tree[i])
+         {
+            distance[i] = 0;
+            queue.emplace(0, i);
+         }
+      }
+      size_t reached = std::numeric_limits<size_t>::max();
+      while (!queue.empty())
+      {
+         queue_entry current = queue.top();
+         queue.pop();
+         size_t v = current.second;
+         if (current.first != distance[v])
+         {
+            continue;
+         }
+         if (!in_tree[v] && instance._vertices[v]._terminal_number < instance._terminals.size())
+         {
+            reached = v;
+            break;
+         }
+         for (neighbour const & n : instance._vertices[v]._neighbours)
+         {
+            DISTANCE_T d = current.first + n._distance;
+            if (d < distance[n._vertex])
+            {
+               distance[n._vertex] = d;
+               predecessor[n._vertex] = v;
+               queue.emplace(d, n._vertex);
+            }
+         }
+      }
+      if (reached == std::numeric_limits<size_t>::max())
+      {
+         throw std::runtime_error("Terminal not reachable");
+      }
+      length += distance[reached];
+      for (size_t v = reached; !in_tree[v]; v = predecessor[v])
+      {
+         in_tree[v] = true;
+         edges.emplace_back(v, predecessor[v]);
+      }
    }
-   for (size_t i = 0; i < num_terminals; ++i)
+   return length;
+}
+
+/*Optima of all pairs and triples of terminals, computed once per search so that small_subset_lower_bound only adds the vertex*/
+struct subset_lower_bound_table
+{
+   size_t _num_terminals;
+   std::vector<DISTANCE_T> _pair_lengths;     /*distance of terminals i and j at i * num_terminals + j*/
+   std::vector<DISTANCE_T> _triple_lengths;   /*extent of the bounding box of terminals i < j < l at (i * num_terminals + j) * num_terminals + l*/
+
+   subset_lower_bound_table(steiner_instance const & instance);
+};
+
+static DISTANCE_T evaluate_subset_lower_bound(BITSET terminal_key, size_t vertex, steiner_instance const & instance, subset_lower_bound_table const *table);
+
+/*State of the labelling algorithm between two calls of step*/
+struct DijkstraSteinerSearch::search_state
+{
+   DISTANCE_T (*_lower_bound)(BITSET terminal_key, size_t vertex, steiner_instance const &);
+   steiner_instance const & _instance;
+   /*Only for small_subset_lower_bound*/
+   std::unique_ptr<subset_lower_bound_table> _subset_table;
+   dijkstra_steiner_settings _settings;
+   bool _small_memory_mode;
+   bool _out_of_core_mode;
+   bool _superset_dominance;
+   size_t _num_vertices;
+   size_t _num_terminals;
+   size_t _num_keyed_terminals;
+   std::vector<node*> _node_heap;
+   /*Vertices which were never reached have no labels and cost a null pointer only*/
+   std::vector<std::unique_ptr<vertex_labels> > _labels;
+   /*In out of core mode the permanent labels go to spill files by terminal count, a full file is followed by another one*/
+   std::vector<std::vector<std::unique_ptr<SpillFile> > > _spill_files;
+   size_t _spill_reserved_bytes;
+   size_t _memory_budget;
+   dijkstra_steiner_memory_usage _memory;
+   size_t _trie_width;
+   /*Keys are key_denominator * steinerlength + key_numerator * lower bound, which orders the labels exactly by steinerlength
+   plus the lower bound weighted by key_numerator / key_denominator <= 1 + epsilon*/
+   uint64_t _key_denominator;
+   uint64_t _key_numerator;
+   /*Labels whose lower bound exceeds this can't be part of an optimal tree, they are only dropped when memory gets short*/
+   DISTANCE_T _upper_bound;
+   BITSET _all_terminal_key;
+   DISTANCE_T _current_steinerlength;
+   light_node *_current_node;
+   /*With an admissible lower bound every popped key is at most key_numerator times the optimum*/
+   uint64_t _popped_key;
+   /*Permanent label with the most terminals, the start of the tree returned when the search is stopped early*/
+   light_node *_best_partial;
+   uint8_t _best_partial_count;
+   size_t _num_extracted;
+   bool _finished;
+   bool _limit_reached;
+   std::chrono::steady_clock::time_point _start_time;
+#ifdef DIJKSTRA_STEINER_STATISTICS
+   dijkstra_steiner_statistics _statistics;
+   std::chrono::steady_clock::time_point _progress_time;
+#endif
+
+   search_state(
+      DISTANCE_T (*lower_bound)(BITSET terminal_key, size_t vertex, steiner_instance const &),
+      steiner_instance const & instance,
+      dijkstra_steiner_settings const & settings);
+
+   ~search_state();
+
+   DISTANCE_T lower_bound(BITSET terminal_key, size_t vertex) const;
+
+   vertex_labels & get_labels(size_t v);
+
+   void insert_label(BitSetMap<light_node> & tree, BITSET key, light_node & label);
+
+   bool is_dominated(vertex_labels const & current, BITSET key, DISTANCE_T steinerlength) const;
+
+   void update_front(vertex_labels & current, BITSET key, DISTANCE_T steinerlength);
+
+   void escalate_memory();
+
+   void relax(BITSET current_terminal_key);
+
+   void merge(vertex_labels & current_labels, BITSET current_terminal_key, light_node *p_node, BITSET p_terminal_key, DISTANCE_T p_steinerlength);
+
+   bool extract();
+};
+
+DijkstraSteinerSearch::search_state::search_state(
+   DISTANCE_T (*lower_bound)(BITSET terminal_key, size_t vertex, steiner_instance const &),
+   steiner_instance const & instance,
+   dijkstra_steiner_settings const & settings) :
+   _lower_bound(lower_bound),
+   _instance(instance),
+   _subset_table(lower_bound == small_subset_lower_bound ? new subset_lower_bound_table(instance) : nullptr),
+   _settings(settings),
+   _small_memory_mode(settings._small_memory_mode),
+   _out_of_core_mode(settings._out_of_core_mode),
+   _superset_dominance(settings._superset_dominance),
+   _num_vertices(instance._vertices.size()),
+   _num_terminals(instance._terminals.size()),
+   /*t is the root and not part of any key*/
+   _num_keyed_terminals(_num_terminals - 1),
+   _labels(_num_vertices),
+   _spill_files(_out_of_core_mode ? _num_keyed_terminals + 1 : 0),
+   /*Each file reserves the memory budget, which is far more than the labels of one terminal count take in memory*/
+   _spill_reserved_bytes(settings._memory_budget_bytes == 0 ? spill_reserved_bytes : (settings._memory_budget_bytes / spill_reserved_step_bytes + 1) * spill_reserved_step_bytes),
+   _memory_budget(settings._memory_budget_bytes),
+   _trie_width(std::max(std::min(settings._maximum_heap_width, _num_keyed_terminals), size_t(1))),
+   _key_denominator(settings._epsilon == 0 ? 1 : uint64_t(1) << 16),
+   _key_numerator(settings._epsilon == 0 ? 1 : std::max(uint64_t((1 + settings._epsilon) * _key_denominator), _key_denominator)),
+   _upper_bound(std::numeric_limits<DISTANCE_T>::max()),
+   _current_steinerlength(0),
+   _current_node(nullptr),
+   _popped_key(0),
+   _best_partial(nullptr),
+   _best_partial_count(0),
+   _num_extracted(0),
+   _finished(false),
+   _limit_reached(false),
+   _start_time(std::chrono::steady_clock::now())
+{
+   STATISTICS(_progress_time = _start_time;)
+   _node_heap.reserve(_num_terminals);
+   if (_memory_budget != 0)
+   {
+      /*Each reached vertex allocates a trie root, all of them together may take at most a quarter of the budget*/
+      size_t num_included = std::count_if(instance._vertices.begin(), instance._vertices.end(), [](vertex const & v){return !v._is_excluded;});
+      while (_trie_width > 1 && num_included * BitSetMap<light_node>::root_memory_usage(_num_keyed_terminals, _trie_width) > _memory_budget / 4)
+      {
+         --_trie_width;
+      }
+   }
+   _memory._extracted_bytes = _labels.size() * sizeof(std::unique_ptr<vertex_labels>);
+   for (size_t i = 0; i < _num_terminals; ++i)
    {
-      if (vertices[instance._terminals[i]]._is_excluded)
+      if (instance._vertices[instance._terminals[i]]._is_excluded)
       {
          throw std::runtime_error("Terminal marked as excluded");
       }
    }
    /*t will be last terminal*/
-   for (size_t i = 0; i < num_terminals - 1; ++i)
+   for (size_t i = 0; i < _num_keyed_terminals; ++i)
    {
       node & n = *(new node());
       n._v = instance._terminals[i];
-      n._terminal_key = 1u << i;
-      n._lower_bound_steinerlength = lower_bound(n._terminal_key, n._v, instance);
+      n._terminal_key = BITSET(1) << i;
+      n._lower_bound_steinerlength = _key_numerator * this->lower_bound(n._terminal_key, n._v);
       n._steinerlength = 0;
-      node_heap.push_back(&n);
-      node_tree[n._v].insert_element(n._terminal_key, n);
+      STATISTICS(++_statistics._labels_created; ++_statistics._lower_bound_calls;)
+      _node_heap.push_back(&n);
+      insert_label(get_labels(n._v)._tree, n._terminal_key, n);
+      _memory._label_bytes += sizeof(node);
    }
-   heap::make_heap(node_heap.begin(), node_heap.end(), node_comparator, node_index_set);
-   BITSET last_terminal_key = 1u << (num_terminals - 1); /*2^(terminals size - 1) - 1 is all terminals without last*/
-   DISTANCE_T current_steinerlength;
-   light_node *current_node;
-   while (true)
+   heap::make_heap(_node_heap.begin(), _node_heap.end(), node_comparator, node_index_set);
+   BITSET last_terminal_key = BITSET(1) << (_num_terminals - 1); /*2^(terminals size - 1) - 1 is all terminals without last*/
+   _all_terminal_key = last_terminal_key - 1;
+}
+
+DijkstraSteinerSearch::search_state::~search_state()
+{
+   std::for_each(_node_heap.begin(), _node_heap.end(), UTIL::delete_functor);
+   for (std::unique_ptr<vertex_labels> const & current : _labels)
    {
-      if (node_heap.empty())
+      if (!current)
+      {
+         continue;
+      }
+      for (std::vector<extracted_node_t> const & current_extracted : current->_extracted)
       {
-         throw std::runtime_error("Empty heap");
+         for (extracted_node_t const & e : current_extracted)
+         {
+            delete e._node;
+         }
       }
+   }
+}
 
-      node & tmp = *node_heap.front();
-      node_heap.front() = node_heap.back();
-      heap::shift_down(node_heap.begin(), node_heap.end(), node_comparator, node_index_set, 0);
-      node_heap.pop_back();
+DISTANCE_T DijkstraSteinerSearch::search_state::lower_bound(BITSET terminal_key, size_t vertex) const
+{
+   return _subset_table ? evaluate_subset_lower_bound(terminal_key, vertex, _instance, _subset_table.get()) : _lower_bound(terminal_key, vertex, _instance);
+}
 
-      size_t current_node_v = tmp._v;
-      BITSET current_terminal_key = tmp._terminal_key;
-      current_steinerlength = tmp._steinerlength;
-      uint8_t current_terminal_count = __builtin_popcount(current_terminal_key);
+vertex_labels & DijkstraSteinerSearch::search_state::get_labels(size_t v)
+{
+   std::unique_ptr<vertex_labels> & current = _labels[v];
+   if (!current)
+   {
+      current.reset(new vertex_labels(_num_keyed_terminals, _trie_width, _out_of_core_mode));
+      _memory._trie_bytes += current->_tree.memory_usage();
+      _memory._extracted_bytes += sizeof(vertex_labels)
+         + current->_extracted.capacity() * sizeof(std::vector<extracted_node_t>)
+         + current->_spilled.capacity() * sizeof(spill_block*);
+   }
+   return *current;
+}
+
+void DijkstraSteinerSearch::search_state::insert_label(BitSetMap<light_node> & tree, BITSET key, light_node & label)
+{
+   size_t trie_bytes = tree.memory_usage();
+   tree.insert_element(key, label);
+   _memory._trie_bytes += tree.memory_usage() - trie_bytes;
+}
 
-      current_node = small_memory_mode ? new light_node(tmp) : &tmp;
-      if (small_memory_mode)
+/*A label with more terminals and no greater steinerlength at the same vertex completes every tree at least as cheap*/
+bool DijkstraSteinerSearch::search_state::is_dominated(vertex_labels const & current, BITSET key, DISTANCE_T steinerlength) const
+{
+   uint8_t terminal_count = __builtin_popcountll(key);
+   for (dominance_entry const & e : current._front)
+   {
+      if (e._terminal_count <= terminal_count)
       {
-         node_tree[current_node_v].insert_element(current_terminal_key, *current_node);
-         delete &tmp;
+         return false;
       }
-      size_t offset = current_node_v * num_terminals;
-      extracted[offset + current_terminal_count].emplace_back(current_node, current_terminal_key, current_steinerlength);
- 
-      if (current_node_v == instance._terminals[num_terminals - 1] && current_terminal_key == last_terminal_key - 1)
+      if ((e._key & key) == key && e._steinerlength <= steinerlength)
       {
-         break;
+         return true;
       }
+   }
+   return false;
+}
 
-      std::vector<neighbour> const & neighbours = vertices[current_node_v]._neighbours;
-      for (neighbour const & current_neighbour : neighbours)
-      {
-         DISTANCE_T neighbour_steinerlength = current_steinerlength + current_neighbour._distance;
-         size_t w_index = current_neighbour._vertex;
-         BITSET tmp_terminal_key = current_terminal_key | ((last_terminal_key - 1) & (1 << vertices[w_index]._terminal_number));
+void DijkstraSteinerSearch::search_state::update_front(vertex_labels & current, BITSET key, DISTANCE_T steinerlength)
+{
+   std::vector<dominance_entry> & front = current._front;
+   size_t front_capacity = front.capacity();
+   front.erase(std::remove_if(front.begin(), front.end(), [key, steinerlength](dominance_entry const & e){return (e._key & key) == e._key && e._steinerlength >= steinerlength;}), front.end());
+   dominance_entry entry(key, steinerlength);
+   front.insert(std::upper_bound(front.begin(), front.end(), entry, [](dominance_entry const & lhs, dominance_entry const & rhs){return lhs._terminal_count > rhs._terminal_count;}), entry);
+   _memory._extracted_bytes += (front.capacity() - front_capacity) * sizeof(dominance_entry);
+}
 
-         node *n = (node*)node_tree[w_index].get_element(tmp_terminal_key);
-         if (n == nullptr)
+void DijkstraSteinerSearch::search_state::escalate_memory()
+{
+   _memory._heap_bytes = _node_heap.capacity() * sizeof(node*);
+   size_t memory_total = _memory.total();
+   while (_memory_budget != 0 && _memory._escalation < 3 && memory_total > _memory_budget / 100 * memory_escalation_percent[_memory._escalation])
+   {
+      switch (++_memory._escalation)
+      {
+         case 1:
+            _small_memory_mode = true;
+            break;
+         case 2:
+            _trie_width = std::max(std::min(_trie_width, _num_keyed_terminals) / 2, size_t(1));
+            _memory._trie_bytes = 0;
+            for (std::unique_ptr<vertex_labels> & current : _labels)
+            {
+               if (current)
+               {
+                  current->_tree.set_chunk_size(_trie_width);
+                  _memory._trie_bytes += current->_tree.memory_usage();
+               }
+            }
+            break;
+         case 3:
          {
-            n = new node();
-            n->_v = w_index;
-            n->_terminal_key = tmp_terminal_key;
-            n->_lower_bound_steinerlength = neighbour_steinerlength + lower_bound(tmp_terminal_key, w_index, instance);
-            n->_heap_index = node_heap.size();
-            node_heap.push_back(n);
-            node_tree[w_index].insert_element(tmp_terminal_key, *n);
+            _upper_bound = terminal_spanning_tree_length(_instance);
+            size_t num_kept = 0;
+            for (node *n : _node_heap)
+            {
+               /*The weighted key can only exceed the scaled upper bound if the unweighted one exceeds the upper bound*/
+               if (n->_lower_bound_steinerlength > _key_numerator * _upper_bound)
+               {
+                  _labels[n->_v]->_tree.erase_element(n->_terminal_key);
+                  delete n;
+                  _memory._label_bytes -= sizeof(node);
+                  STATISTICS(++_statistics._labels_discarded;)
+               }
+               else
+               {
+                  _node_heap[num_kept++] = n;
+               }
+            }
+            _node_heap.resize(num_kept);
+            _node_heap.shrink_to_fit();
+            heap::make_heap(_node_heap.begin(), _node_heap.end(), node_comparator, node_index_set);
+            _memory._heap_bytes = _node_heap.capacity() * sizeof(node*);
+            break;
          }
-         else if (n->_steinerlength > neighbour_steinerlength)
+      }
+      memory_total = _memory.total();
+   }
+   _memory._peak_bytes = std::max(_memory._peak_bytes, memory_total);
+   if (_memory_budget != 0 && memory_total > _memory_budget)
+   {
+      throw std::runtime_error("Memory budget exceeded");
+   }
+}
+
+void DijkstraSteinerSearch::search_state::relax(BITSET current_terminal_key)
+{
+   std::vector<vertex>::const_iterator vertices = _instance._vertices.begin();
+   std::vector<neighbour> const & neighbours = vertices[_current_node->_v]._neighbours;
+   for (neighbour const & current_neighbour : neighbours)
+   {
+      DISTANCE_T neighbour_steinerlength = _current_steinerlength + current_neighbour._distance;
+      size_t w_index = current_neighbour._vertex;
+      uint8_t w_terminal_number = vertices[w_index]._terminal_number;
+      BITSET tmp_terminal_key = current_terminal_key | (w_terminal_number < _num_keyed_terminals ? BITSET(1) << w_terminal_number : 0);
+      if (_superset_dominance && _labels[w_index] && is_dominated(*_labels[w_index], tmp_terminal_key, neighbour_steinerlength))
+      {
+         STATISTICS(++_statistics._labels_dominated;)
+         continue;
+      }
+
+      node *n = _labels[w_index] ? (node*)_labels[w_index]->_tree.get_element(tmp_terminal_key) : nullptr;
+      if (n == nullptr)
+      {
+         DISTANCE_T w_lower_bound = lower_bound(tmp_terminal_key, w_index);
+         STATISTICS(++_statistics._lower_bound_calls;)
+         if (neighbour_steinerlength + w_lower_bound > _upper_bound)
          {
-            n->_lower_bound_steinerlength = neighbour_steinerlength + (n->_lower_bound_steinerlength - n->_steinerlength);
+            STATISTICS(++_statistics._labels_discarded;)
+            continue;
          }
-         else
+         n = new node();
+         n->_v = w_index;
+         n->_terminal_key = tmp_terminal_key;
+         n->_lower_bound_steinerlength = _key_denominator * neighbour_steinerlength + _key_numerator * w_lower_bound;
+         n->_heap_index = _node_heap.size();
+         _node_heap.push_back(n);
+         insert_label(get_labels(w_index)._tree, tmp_terminal_key, *n);
+         _memory._label_bytes += sizeof(node);
+         STATISTICS(++_statistics._labels_created;)
+      }
+      else if (!n->_permanent && n->_steinerlength > neighbour_steinerlength)
+      {
+         /*Only with a weighted lower bound a permanent label can be improved, it is kept to preserve the 1 + epsilon bound*/
+         n->_lower_bound_steinerlength = _key_denominator * neighbour_steinerlength + (n->_lower_bound_steinerlength - _key_denominator * n->_steinerlength);
+         STATISTICS(++_statistics._labels_decreased;)
+      }
+      else
+      {
+         STATISTICS(++_statistics._labels_discarded;)
+         continue;
+      }
+      n->_steinerlength = neighbour_steinerlength;
+      heap::shift_up(_node_heap.begin(), node_comparator, node_index_set, n->_heap_index);
+      n->prev0 = n->prev1 = _current_node;
+   }
+}
+
+void DijkstraSteinerSearch::search_state::merge(vertex_labels & current_labels, BITSET current_terminal_key, light_node *p_node, BITSET p_terminal_key, DISTANCE_T p_steinerlength)
+{
+   STATISTICS(++_statistics._merges_accepted;)
+   DISTANCE_T added_steinerlength = _current_steinerlength + p_steinerlength;
+   BITSET  union_terminal_key = current_terminal_key | p_terminal_key;
+   if (_superset_dominance && is_dominated(current_labels, union_terminal_key, added_steinerlength))
+   {
+      STATISTICS(++_statistics._labels_dominated;)
+      return;
+   }
+   size_t current_node_v = _current_node->_v;
+   node *k = (node*)current_labels._tree.get_element(union_terminal_key);
+   if (k == nullptr)
+   {
+      DISTANCE_T union_lower_bound = lower_bound(union_terminal_key, current_node_v);
+      STATISTICS(++_statistics._lower_bound_calls;)
+      if (added_steinerlength + union_lower_bound > _upper_bound)
+      {
+         STATISTICS(++_statistics._labels_discarded;)
+         return;
+      }
+      k = new node();  //terminals of n and current_node are disjoint
+      k->_v = current_node_v;
+      k->_terminal_key = union_terminal_key;
+      k->_steinerlength = added_steinerlength;
+      k->_lower_bound_steinerlength = _key_denominator * added_steinerlength + _key_numerator * union_lower_bound;
+      k->_heap_index = _node_heap.size();
+      _node_heap.push_back(k);
+      insert_label(current_labels._tree, union_terminal_key, *k);
+      _memory._label_bytes += sizeof(node);
+      STATISTICS(++_statistics._labels_created;)
+   }
+   else if(!k->_permanent && k->_steinerlength > added_steinerlength)
+   {
+      k->_lower_bound_steinerlength = (k->_lower_bound_steinerlength - _key_denominator * k->_steinerlength) + _key_denominator * added_steinerlength;
+      STATISTICS(++_statistics._labels_decreased;)
+   }
+   else
+   {
+      STATISTICS(++_statistics._labels_discarded;)
+      return;
+   }
+   k->_steinerlength = added_steinerlength;
+   heap::shift_up(_node_heap.begin(), node_comparator, node_index_set, k->_heap_index);
+   k->prev0 = _current_node;
+   k->prev1 = p_node;
+}
+
+/*Extracts the label with the smallest key and extends it, returns false if the search is finished or hit a limit*/
+bool DijkstraSteinerSearch::search_state::extract()
+{
+   if (_finished || _limit_reached)
+   {
+      return false;
+   }
+   if (_node_heap.empty())
+   {
+      throw std::runtime_error("Empty heap");
+   }
+   if ((_settings._label_limit != 0 && _num_extracted >= _settings._label_limit)
+      || (_settings._time_limit_seconds != 0 && std::chrono::duration<double>(std::chrono::steady_clock::now() - _start_time).count() >= _settings._time_limit_seconds))
+   {
+      _limit_reached = true;
+      return false;
+   }
+   escalate_memory();
+
+   STATISTICS(_statistics._peak_heap_size = std::max(_statistics._peak_heap_size, _node_heap.size());)
+   node & tmp = *_node_heap.front();
+   _node_heap.front() = _node_heap.back();
+   heap::shift_down(_node_heap.begin(), _node_heap.end(), node_comparator, node_index_set, 0);
+   _node_heap.pop_back();
+   if (_superset_dominance)
+   {
+      vertex_labels & current = *_labels[tmp._v];
+      if (is_dominated(current, tmp._terminal_key, tmp._steinerlength))
+      {
+         current._tree.erase_element(tmp._terminal_key);
+         delete &tmp;
+         _memory._label_bytes -= sizeof(node);
+         STATISTICS(++_statistics._labels_dominated;)
+         return true;
+      }
+      update_front(current, tmp._terminal_key, tmp._steinerlength);
+   }
+
+   size_t current_node_v = tmp._v;
+   BITSET current_terminal_key = tmp._terminal_key;
+   _current_steinerlength = tmp._steinerlength;
+   uint8_t current_terminal_count = __builtin_popcountll(current_terminal_key);
+   _popped_key = std::max(_popped_key, tmp._lower_bound_steinerlength);
+   ++_num_extracted;
+   tmp._permanent = true;
+#ifdef DIJKSTRA_STEINER_STATISTICS
+   ++_statistics._labels_extracted;
+   if (_settings._progress_callback != nullptr && _settings._progress_interval != 0 && _statistics._labels_extracted % _settings._progress_interval == 0)
+   {
+      auto now = std::chrono::steady_clock::now();
+      dijkstra_steiner_progress progress;
+      progress._labels_extracted = _statistics._labels_extracted;
+      progress._terminal_key = current_terminal_key;
+      progress._steinerlength = _current_steinerlength;
+      progress._heap_size = _node_heap.size();
+      progress._labels_per_second = _settings._progress_interval / std::chrono::duration<double>(now - _progress_time).count();
+      _progress_time = now;
+      _settings._progress_callback(progress, _settings._progress_data);
+   }
+#endif
+
+   vertex_labels & current_labels = *_labels[current_node_v];
+   if (_out_of_core_mode)
+   {
+      spill_block *&block = current_labels._spilled[current_terminal_count];
+      if (block == nullptr || block->_size == block->_capacity)
+      {
+         uint32_t capacity = block == nullptr ? spill_block_min_labels : std::min(block->_capacity * 2, spill_block_max_labels);
+         size_t block_bytes = sizeof(spill_block) + capacity * sizeof(spilled_label);
+         std::vector<std::unique_ptr<SpillFile> > & spill_files = _spill_files[current_terminal_count];
+         if (spill_files.empty() || !spill_files.back()->fits(block_bytes))
          {
-            continue;
+            spill_files.emplace_back(new SpillFile(_settings._spill_directory, _spill_reserved_bytes));
          }
-         n->_steinerlength = neighbour_steinerlength;
-         heap::shift_up(node_heap.begin(), node_comparator, node_index_set, n->_heap_index);
-         n->prev0 = n->prev1 = current_node;
+         size_t spilled_bytes = spill_files.back()->size();
+         spill_block *next = new (spill_files.back()->append(block_bytes)) spill_block();
+         _memory._spilled_bytes += spill_files.back()->size() - spilled_bytes;
+         next->_next = block;
+         next->_size = 0;
+         next->_capacity = capacity;
+         block = next;
+      }
+      spilled_label *s = new (block->labels() + block->_size++) spilled_label();
+      static_cast<light_node&>(*s) = tmp;
+      s->_terminal_key = current_terminal_key;
+      insert_label(current_labels._tree, current_terminal_key, *s);
+      delete &tmp;
+      _memory._label_bytes -= sizeof(node);
+      _current_node = s;
+   }
+   else
+   {
+      _current_node = _small_memory_mode ? new light_node(tmp) : &tmp;
+      if (_small_memory_mode)
+      {
+         insert_label(current_labels._tree, current_terminal_key, *_current_node);
+         delete &tmp;
+         _memory._label_bytes -= sizeof(node) - sizeof(light_node);
       }
+      std::vector<extracted_node_t> & current_extracted = current_labels._extracted[current_terminal_count];
+      size_t extracted_capacity = current_extracted.capacity();
+      current_extracted.emplace_back(_current_node, current_terminal_key, _current_steinerlength);
+      _memory._extracted_bytes += (current_extracted.capacity() - extracted_capacity) * sizeof(extracted_node_t);
+   }
+   if (current_terminal_count > _best_partial_count || (current_terminal_count == _best_partial_count && _current_steinerlength < _best_partial->_steinerlength))
+   {
+      _best_partial = _current_node;
+      _best_partial_count = current_terminal_count;
+   }
+
+   if (current_node_v == _instance._terminals[_num_terminals - 1] && current_terminal_key == _all_terminal_key)
+   {
+      _finished = true;
+      return false;
+   }
 
-      BitSetMap<light_node> & current_node_tree = node_tree[current_node_v];
-      BITSET key = current_terminal_key | last_terminal_key;  //this implements I union t
-      for (uint8_t j = 1; j < num_terminals - current_terminal_count; ++j) //first entry is the zero key, which we ignore
+   relax(current_terminal_key);
+
+   /*Trees meeting in a terminal share it, so both keys may contain the terminal itself*/
+   uint8_t current_terminal_number = _instance._vertices[current_node_v]._terminal_number;
+   BITSET own_terminal_key = current_terminal_number < _num_keyed_terminals ? BITSET(1) << current_terminal_number : 0;
+   BITSET key = current_terminal_key & ~own_terminal_key;
+   for (uint8_t j = 1; j <= _num_keyed_terminals - current_terminal_count + (own_terminal_key != 0); ++j) //first entry is the zero key, which we ignore
+   {
+      if (_out_of_core_mode)
       {
-         for (extracted_node_t const & current : extracted[offset + j])
+         for (spill_block *block = current_labels._spilled[j]; block != nullptr; block = block->_next)
          {
-            BITSET p_terminal_key = current._key;
-            if (!(p_terminal_key & key)) // this asks for whether the nodes coincide and if J is a subset of I union t complement
+            spilled_label *labels = block->labels();
+            for (uint32_t i = 0; i < block->_size; ++i)
             {
-               DISTANCE_T added_steinerlength = current_steinerlength + current._dist;
-               BITSET  union_terminal_key = current_terminal_key | p_terminal_key;
-               node *k = (node*)current_node_tree.get_element(union_terminal_key);
-               if (k == nullptr)
-               {
-                  k = new node();  //terminals of n and current_node are disjoint
-                  k->_v = current_node_v;
-                  k->_terminal_key = union_terminal_key;
-                  k->_steinerlength = added_steinerlength;
-                  k->_lower_bound_steinerlength = added_steinerlength + lower_bound(union_terminal_key, current_node_v, instance);
-                  k->_heap_index = node_heap.size();
-                  node_heap.push_back(k);
-                  current_node_tree.insert_element(union_terminal_key, *k);
-               }
-               else if(k->_steinerlength > added_steinerlength)
-               {
-                  k->_lower_bound_steinerlength = (k->_lower_bound_steinerlength - k->_steinerlength) + added_steinerlength;
-               }
-               else
+               STATISTICS(++_statistics._merges_scanned;)
+               if (!(labels[i]._terminal_key & key)) // this asks for whether the nodes coincide and if J is a subset of I union t complement
                {
-                  continue;
+                  merge(current_labels, current_terminal_key, &labels[i], labels[i]._terminal_key, labels[i]._steinerlength);
                }
-               k->_steinerlength = added_steinerlength;
-               heap::shift_up(node_heap.begin(), node_comparator, node_index_set, k->_heap_index);
-               k->prev0 = current_node;
-               k->prev1 = current._node;
+            }
+         }
+      }
+      else
+      {
+         for (extracted_node_t const & current : current_labels._extracted[j])
+         {
+            STATISTICS(++_statistics._merges_scanned;)
+            if (!(current._key & key))
+            {
+               merge(current_labels, current_terminal_key, current._node, current._key, current._dist);
             }
          }
       }
    }
+   return true;
+}
+
+DijkstraSteinerSearch::DijkstraSteinerSearch(
+   DISTANCE_T (*lower_bound)(BITSET terminal_key, size_t vertex, steiner_instance const &),
+   steiner_instance const & instance,
+   dijkstra_steiner_settings const & settings) :
+   _state(new search_state(lower_bound, instance, settings)){}
+
+DijkstraSteinerSearch::~DijkstraSteinerSearch(){}
+
+bool DijkstraSteinerSearch::step(size_t max_extractions)
+{
+   for (size_t i = 0; i < max_extractions && _state->extract(); ++i){}
+   return is_done();
+}
+
+bool DijkstraSteinerSearch::is_done() const
+{
+   return _state->_finished || _state->_limit_reached;
+}
+
+bool DijkstraSteinerSearch::is_optimal() const
+{
+   return _state->_finished;
+}
 
-   track_back(edges, *current_node);
-   std::for_each(node_heap.begin(), node_heap.end(), UTIL::delete_functor);
-   for (size_t i = 0; i < extracted.size(); ++i)
+DISTANCE_T DijkstraSteinerSearch::lower_bound() const
+{
+   search_state const & state = *_state;
+   uint64_t key = state._popped_key;
+   if (!state._finished && !state._node_heap.empty())
+   {
+      key = std::max(key, state._node_heap.front()->_lower_bound_steinerlength);
+   }
+   return DISTANCE_T((key + state._key_numerator - 1) / state._key_numerator);
+}
+
+size_t DijkstraSteinerSearch::labels_extracted() const
+{
+   return _state->_num_extracted;
+}
+
+dijkstra_steiner_memory_usage const & DijkstraSteinerSearch::memory_usage() const
+{
+   return _state->_memory;
+}
+
+DISTANCE_T DijkstraSteinerSearch::result(std::vector<std::pair<size_t, size_t> > & edges) const
+{
+   search_state const & state = *_state;
+   steiner_instance const & instance = state._instance;
+   DISTANCE_T length;
+   if (!state._finished)
    {
-      for (size_t j = 0; j < extracted[i].size(); ++j)
+      /*Extend the largest permanent label by shortest paths, its length bounds the optimum from above*/
+      std::vector<bool> in_tree(state._num_vertices, false);
+      size_t first_edge = edges.size();
+      if (state._best_partial != nullptr)
       {
-          delete extracted[i][j]._node;
+         track_back(edges, *state._best_partial);
+         in_tree[state._best_partial->_v] = true;
+         length = state._best_partial->_steinerlength;
       }
-      //std::for_each(extracted_nodes[i].begin(), extracted_nodes[i].end(), UTIL::delete_functor);
+      else
+      {
+         in_tree[instance._terminals.back()] = true;
+         length = 0;
+      }
+      for (size_t i = first_edge; i < edges.size(); ++i)
+      {
+         in_tree[edges[i].first] = in_tree[edges[i].second] = true;
+      }
+      length += connect_terminals(instance, in_tree, edges);
+   }
+   else
+   {
+      track_back(edges, *state._current_node);
+      length = state._current_steinerlength;
+   }
+   dijkstra_steiner_settings const & settings = state._settings;
+   if (settings._bounds != nullptr)
+   {
+      settings._bounds->_lower_bound = std::min(lower_bound(), length);
+      settings._bounds->_upper_bound = length;
+      settings._bounds->_labels_extracted = state._num_extracted;
+   }
+   if (settings._memory_usage != nullptr)
+   {
+      *settings._memory_usage = state._memory;
+   }
+#ifdef DIJKSTRA_STEINER_STATISTICS
+   if (settings._statistics != nullptr)
+   {
+      *settings._statistics = state._statistics;
+      for (std::unique_ptr<vertex_labels> const & current : state._labels)
+      {
+         if (current)
+         {
+            settings._statistics->_trie_layers += current->_tree.num_layers();
+         }
+      }
+   }
+#endif
+   return length;
+}
+
+DISTANCE_T calculate_steinertree(
+   DISTANCE_T (*lower_bound)(BITSET terminal_key, size_t vertex, steiner_instance const &),
+   steiner_instance const & instance,
+   dijkstra_steiner_settings const & settings,
+   std::vector<std::pair<size_t, size_t> > & edges)
+{
+   if (settings._distributed_workers != 0)
+   {
+      return calculate_steinertree_distributed(lower_bound, instance, settings, edges);
    }
-   return current_steinerlength;
+   ScopedPhase phase(settings._trace, "search");
+   DijkstraSteinerSearch search(lower_bound, instance, settings);
+   search.step(std::numeric_limits<size_t>::max());
+   phase.next(search.is_optimal() ? "track_back" : "complete partial tree");
+   DISTANCE_T length = search.result(edges);
+   phase.next("free labels");
+   return length;
 }
 
 DISTANCE_T zero_lower_bound(BITSET , size_t , steiner_instance const & ){
@@ -594,7 +1456,8 @@ DISTANCE_T zero_lower_bound(BITSET , size_t , steiner_instance const & ){
 
 DISTANCE_T boundingbox_lower_bound(BITSET terminal_key, size_t vertex, steiner_instance const & instance)
 {
-   static std::vector<COOR> minmaxc;
+   /*Per thread, since portfolio configurations evaluate the bound concurrently*/
+   static thread_local std::vector<COOR> minmaxc;
    size_t dim = instance._sizes.size();
 
    minmaxc.clear();
@@ -628,3 +1491,133 @@ DISTANCE_T boundingbox_lower_bound(BITSET terminal_key, size_t vertex, steiner_i
    }
    return length;
 }
+
+/*Only labels with at most this many remaining terminals look at their triples, which keeps the bound consistent
+since the remaining terminals only become fewer along a path of labels*/
+static const size_t subset_lower_bound_max_remaining = 8;
+
+subset_lower_bound_table::subset_lower_bound_table(steiner_instance const & instance) :
+   _num_terminals(instance._terminals.size()),
+   _pair_lengths(_num_terminals * _num_terminals, 0),
+   _triple_lengths(_num_terminals * _num_terminals * _num_terminals, 0)
+{
+   size_t dim = instance._sizes.size();
+   std::vector<COOR> const & coords = instance._terminal_coords;
+   for (size_t i = 0; i < _num_terminals; ++i)
+   {
+      for (size_t j = i + 1; j < _num_terminals; ++j)
+      {
+         for (size_t a = 0; a < dim; ++a)
+         {
+            _pair_lengths[i * _num_terminals + j] += std::abs(coords[i * dim + a] - coords[j * dim + a]);
+         }
+         _pair_lengths[j * _num_terminals + i] = _pair_lengths[i * _num_terminals + j];
+         for (size_t l = j + 1; l < _num_terminals; ++l)
+         {
+            DISTANCE_T & triple = _triple_lengths[(i * _num_terminals + j) * _num_terminals + l];
+            for (size_t a = 0; a < dim; ++a)
+            {
+               COOR ci = coords[i * dim + a], cj = coords[j * dim + a], cl = coords[l * dim + a];
+               triple += std::max(std::max(ci, cj), cl) - std::min(std::min(ci, cj), cl);
+            }
+         }
+      }
+   }
+}
+
+DISTANCE_T small_subset_lower_bound(BITSET terminal_key, size_t vertex, steiner_instance const & instance)
+{
+   return evaluate_subset_lower_bound(terminal_key, vertex, instance, nullptr);
+}
+
+/*Without a table the pair and triple optima are computed on the fly*/
+static DISTANCE_T evaluate_subset_lower_bound(BITSET terminal_key, size_t vertex, steiner_instance const & instance, subset_lower_bound_table const *table)
+{
+   DISTANCE_T length = boundingbox_lower_bound(terminal_key, vertex, instance);
+   size_t num_terminals = instance._terminals.size();
+   BITSET remaining = ~terminal_key & (num_terminals == std::numeric_limits<BITSET>::digits ? ~BITSET(0) : (BITSET(1) << num_terminals) - 1);
+   size_t num_remaining = __builtin_popcountll(remaining);
+   if (num_remaining < 3 || num_remaining > subset_lower_bound_max_remaining)
+   {
+      return length;
+   }
+   size_t dim = instance._sizes.size();
+   std::vector<COOR> const & v = instance._vertices[vertex]._coords;
+   size_t terminals[subset_lower_bound_max_remaining];
+   DISTANCE_T vertex_distance[subset_lower_bound_max_remaining];
+   size_t num = 0;
+   for (BITSET rest = remaining; rest != 0; rest &= rest - 1, ++num)
+   {
+      terminals[num] = __builtin_ctzll(rest);
+      vertex_distance[num] = 0;
+      for (size_t a = 0; a < dim; ++a)
+      {
+         vertex_distance[num] += std::abs(v[a] - instance._terminal_coords[terminals[num] * dim + a]);
+      }
+   }
+   DISTANCE_T pair_lengths[subset_lower_bound_max_remaining][subset_lower_bound_max_remaining];
+   for (size_t y = 0; y < num; ++y)
+   {
+      for (size_t z = y + 1; z < num; ++z)
+      {
+         if (table != nullptr)
+         {
+            pair_lengths[y][z] = table->_pair_lengths[terminals[y] * num_terminals + terminals[z]];
+            continue;
+         }
+         pair_lengths[y][z] = 0;
+         for (size_t a = 0; a < dim; ++a)
+         {
+            pair_lengths[y][z] += std::abs(instance._terminal_coords[terminals[y] * dim + a] - instance._terminal_coords[terminals[z] * dim + a]);
+         }
+      }
+   }
+   auto triple_length = [&](size_t x, size_t y, size_t z)
+   {
+      if (table != nullptr)
+      {
+         return table->_triple_lengths[(terminals[x] * num_terminals + terminals[y]) * num_terminals + terminals[z]];
+      }
+      DISTANCE_T triple = 0;
+      for (size_t a = 0; a < dim; ++a)
+      {
+         COOR cx = instance._terminal_coords[terminals[x] * dim + a], cy = instance._terminal_coords[terminals[y] * dim + a], cz = instance._terminal_coords[terminals[z] * dim + a];
+         triple += std::max(std::max(cx, cy), cz) - std::min(std::min(cx, cy), cz);
+      }
+      return triple;
+   };
+   /*A tree of v and three terminals x, y, z joins v with one of them, say x, and y with z, its length along an axis
+   is the length of both intervals plus the gap between them*/
+   auto pairing_length = [&](size_t x, size_t y, size_t z)
+   {
+      DISTANCE_T pairing = vertex_distance[x] + pair_lengths[y][z];
+      COOR const *cx = &instance._terminal_coords[terminals[x] * dim];
+      COOR const *cy = &instance._terminal_coords[terminals[y] * dim];
+      COOR const *cz = &instance._terminal_coords[terminals[z] * dim];
+      for (size_t a = 0; a < dim; ++a)
+      {
+         COOR low0 = std::min(v[a], cx[a]), high0 = std::max(v[a], cx[a]);
+         COOR low1 = std::min(cy[a], cz[a]), high1 = std::max(cy[a], cz[a]);
+         pairing += std::max(std::max(low1 - high0, low0 - high1), 0);
+      }
+      return pairing;
+   };
+   for (size_t x = 0; x < num; ++x)
+   {
+      for (size_t y = x + 1; y < num; ++y)
+      {
+         DISTANCE_T nearest_xy = std::min(vertex_distance[x], vertex_distance[y]);
+         for (size_t z = y + 1; z < num; ++z)
+         {
+            /*Joining v to the nearest terminal of the optimal tree of the triple gives a tree, no pairing is longer,
+            so triples which can't exceed the bound so far are skipped*/
+            if (triple_length(x, y, z) + std::min(nearest_xy, vertex_distance[z]) <= length)
+            {
+               continue;
+            }
+            length = std::max(length, std::min(std::min(pairing_length(x, y, z), pairing_length(y, x, z)), pairing_length(z, x, y)));
+         }
+      }
+   }
+   return length;
+}
@@ -24,33 +24,132 @@
 #define DIJKSTRA_STEINER_H
 
 #include <vector>
+#include <string>
+#include <memory>
 #include "util.h"
 
+class PhaseTrace;
+
 struct light_node{
    DISTANCE_T _steinerlength;
+   bool _permanent;                        /*extracted from the heap, fits into the padding after _steinerlength*/
    light_node *prev0, *prev1;
    size_t _v;
 };
 
 struct node : light_node{
    BITSET _terminal_key;
-   DISTANCE_T _lower_bound_steinerlength;
+   uint64_t _lower_bound_steinerlength;    /*steinerlength plus the lower bound, both scaled to weight the lower bound by 1 + _epsilon*/
    size_t _heap_index;
 };
 
+/*Bytes held by the labelling algorithm, spilled labels are file backed and not part of the total*/
+struct dijkstra_steiner_memory_usage{
+   size_t _trie_bytes;
+   size_t _extracted_bytes;
+   size_t _heap_bytes;
+   size_t _label_bytes;
+   size_t _spilled_bytes;
+   size_t _peak_bytes;
+   uint8_t _escalation;                    /*0 none, 1 small memory mode, 2 narrower tries, 3 dropping labels above an upper bound*/
+
+   dijkstra_steiner_memory_usage() : _trie_bytes(0), _extracted_bytes(0), _heap_bytes(0), _label_bytes(0), _spilled_bytes(0), _peak_bytes(0), _escalation(0){}
+
+   size_t total() const{return _trie_bytes + _extracted_bytes + _heap_bytes + _label_bytes;}
+};
+
+/*Counters of the labelling algorithm, only filled when compiled with DIJKSTRA_STEINER_STATISTICS*/
+struct dijkstra_steiner_statistics{
+   size_t _labels_created;
+   size_t _labels_decreased;
+   size_t _labels_extracted;
+   size_t _labels_discarded;               /*candidates not shorter than the existing label or above the upper bound*/
+   size_t _labels_dominated;               /*candidates and extracted labels dominated by a label with more terminals*/
+   size_t _merges_scanned;
+   size_t _merges_accepted;                /*scanned labels with disjoint terminals*/
+   size_t _peak_heap_size;
+   size_t _trie_layers;                    /*layers allocated in the BitSetMap tries at the end of the run*/
+   size_t _lower_bound_calls;
+
+   dijkstra_steiner_statistics() : _labels_created(0), _labels_decreased(0), _labels_extracted(0), _labels_discarded(0), _labels_dominated(0), _merges_scanned(0), _merges_accepted(0), _peak_heap_size(0), _trie_layers(0), _lower_bound_calls(0){}
+};
+
+struct dijkstra_steiner_progress{
+   size_t _labels_extracted;
+   BITSET _terminal_key;
+   DISTANCE_T _steinerlength;
+   size_t _heap_size;
+   double _labels_per_second;              /*extractions since the previous call*/
+};
+
+/*Bounds on the length of an optimal tree, the returned tree has length _upper_bound and is optimal if both are equal*/
+struct dijkstra_steiner_bounds{
+   DISTANCE_T _lower_bound;
+   DISTANCE_T _upper_bound;
+   size_t _labels_extracted;
+
+   dijkstra_steiner_bounds() : _lower_bound(0), _upper_bound(0), _labels_extracted(0){}
+};
+
 struct dijkstra_steiner_settings{
    bool _small_memory_mode;
    size_t _maximum_heap_width;
    bool _edge_as_steinerpoint;
+   size_t _full_steiner_tree_threshold;    /*2d instances with more terminals are solved by concatenating full steiner trees*/
+   size_t _heuristic_threshold;            /*0 for exact solutions, otherwise 2d instances with more terminals are solved heuristically from exactly solved windows*/
+   size_t _heuristic_threshold_high_dim;   /*the same for instances of three or more dimensions, where the grid grows faster with the terminals*/
+   size_t _heuristic_window_size;          /*terminals of the exactly solved windows, larger windows give shorter trees but cost exponentially more*/
+   bool _superset_dominance;               /*drop labels of a vertex if it has a label with more terminals and no greater steinerlength*/
+   bool _autotune;                         /*choose the root and trie width of coordinate instances from their features, the lower bound stays the caller's*/
+   size_t _portfolio_threads;              /*0 or 1 for a single search, otherwise coordinate instances race this many configurations*/
+   size_t _distributed_workers;            /*0 for a search in this process, otherwise the labels are spread over this many worker processes, which support only the time and label limits and throw std::invalid_argument for a memory budget, epsilon, dominance, statistics, memory usage or progress callback*/
+   bool _dense_sweep;                      /*solve coordinate instances below the full steiner tree threshold with the dense sweep engine*/
+   bool _out_of_core_mode;                 /*keep permanent labels in memory mapped files, only the heap and tentative labels stay in memory*/
+   std::string _spill_directory;
+   size_t _memory_budget_bytes;            /*0 for no limit, otherwise cheaper representations are chosen as the labels approach it*/
+   double _epsilon;                        /*weight of the lower bound minus one, the result is at most 1 + _epsilon times optimal*/
+   double _time_limit_seconds;             /*0 for no limit, otherwise the search stops and returns the best tree found so far*/
+   size_t _label_limit;                    /*0 for no limit, otherwise the search stops after extracting this many labels, or after as many steps of the full steiner trees*/
+   dijkstra_steiner_bounds *_bounds;               /*receives the certified gap of the last run if not null*/
+   dijkstra_steiner_memory_usage *_memory_usage;   /*receives the accounting of the last run if not null*/
+   dijkstra_steiner_statistics *_statistics;       /*receives the counters of the last run if not null and compiled with DIJKSTRA_STEINER_STATISTICS*/
+   void (*_progress_callback)(dijkstra_steiner_progress const & progress, void *data);   /*only called when compiled with DIJKSTRA_STEINER_STATISTICS*/
+   void *_progress_data;
+   size_t _progress_interval;              /*extractions between two calls of the progress callback, 0 disables it, only used when compiled with DIJKSTRA_STEINER_STATISTICS*/
+   PhaseTrace *_trace;                     /*receives the durations of the pipeline phases if not null*/
 
    dijkstra_steiner_settings()
    {
       _small_memory_mode = false;
       _maximum_heap_width = 64;
       _edge_as_steinerpoint = true;
+      _full_steiner_tree_threshold = 8;
+      _heuristic_threshold = 0;
+      _heuristic_threshold_high_dim = 0;
+      _heuristic_window_size = 8;
+      _superset_dominance = false;
+      _autotune = false;
+      _portfolio_threads = 0;
+      _distributed_workers = 0;
+      _dense_sweep = false;
+      _out_of_core_mode = false;
+      _spill_directory = "/tmp";
+      _memory_budget_bytes = 0;
+      _epsilon = 0;
+      _time_limit_seconds = 0;
+      _label_limit = 0;
+      _bounds = nullptr;
+      _memory_usage = nullptr;
+      _statistics = nullptr;
+      _progress_callback = nullptr;
+      _progress_data = nullptr;
+      _progress_interval = 1000000;
+      _trace = nullptr;
    }
 };
 
+/*Solves the instance given by its terminal coordinates, the tree is optimal unless a limit is reached or a heuristic threshold is set and exceeded.
+The heuristic tree has no approximation guarantee, _bounds then receives the extent of the terminals as lower bound*/
 DISTANCE_T calculate_steinertree(
    DISTANCE_T (*lower_bound)(BITSET terminal_key, size_t vertex, steiner_instance const &),
    std::vector<std::vector <COOR> > const & terminals,
@@ -59,10 +158,58 @@ DISTANCE_T calculate_steinertree(
    std::vector<std::pair<size_t, size_t> > & edges
 );
 
+void create_hanan_instance(std::vector<std::vector <COOR> > const & terminals, steiner_instance & instance, PhaseTrace *trace = nullptr);
+
+void compress_steinertree(
+   steiner_instance const & instance,
+   std::vector<std::pair<size_t, size_t> > const & grid_edges,
+   dijkstra_steiner_settings const & settings,
+   std::vector<std::vector <COOR> > & steinerpoints,
+   std::vector<std::pair<size_t, size_t> > & edges);
+
 void mark_excluded_vertices(steiner_instance & instance);
 
 void mark_excluded_vertices(std::vector<size_t> const & terminals, std::vector<size_t> const & sizes, std::vector<bool> & is_excluded);
 
+/*Labelling algorithm on a graph instance which can be advanced a number of extractions at a time,
+so that one thread can interleave many searches and drop the hopeless ones*/
+class DijkstraSteinerSearch
+{
+public:
+   DijkstraSteinerSearch(
+      DISTANCE_T (*lower_bound)(BITSET terminal_key, size_t vertex, steiner_instance const &),
+      steiner_instance const & instance,
+      dijkstra_steiner_settings const & settings);
+
+   ~DijkstraSteinerSearch();
+
+   /*Extracts at most max_extractions labels, the label and time limits of the settings count from the construction, returns is_done()*/
+   bool step(size_t max_extractions);
+
+   /*The tree of all terminals was found or a limit was hit*/
+   bool is_done() const;
+
+   bool is_optimal() const;
+
+   /*Certified lower bound of the optimum, rises as the search advances*/
+   DISTANCE_T lower_bound() const;
+
+   size_t labels_extracted() const;
+
+   /*Accounting of the labels so far, the peak is updated with every extraction*/
+   dijkstra_steiner_memory_usage const & memory_usage() const;
+
+   /*The optimal tree if is_optimal(), otherwise the best permanent label completed by shortest paths. Fills the bounds, memory usage and statistics of the settings*/
+   DISTANCE_T result(std::vector<std::pair<size_t, size_t> > & edges) const;
+
+private:
+   struct search_state;
+   std::unique_ptr<search_state> _state;
+
+   DijkstraSteinerSearch(DijkstraSteinerSearch const &) = delete;
+   DijkstraSteinerSearch & operator=(DijkstraSteinerSearch const &) = delete;
+};
+
 DISTANCE_T calculate_steinertree(
    DISTANCE_T (*lower_bound)(BITSET terminal_key, size_t vertex, steiner_instance const &),
    steiner_instance const & instance,
@@ -73,4 +220,20 @@ DISTANCE_T zero_lower_bound(BITSET terminal_key, size_t vertex, steiner_instance
 
 DISTANCE_T boundingbox_lower_bound(BITSET terminal_key, size_t vertex, steiner_instance const & instance);
 
+/*Length of a rectilinear minimum spanning tree of the terminals, an upper bound for the steiner tree*/
+DISTANCE_T terminal_spanning_tree_length(steiner_instance const & instance);
+
+/*Sum of the extents of the terminals along the axes, every tree spans them*/
+DISTANCE_T terminal_extent(std::vector<std::vector<COOR> > const & terminals);
+
+/*Connects the terminals outside of the tree by shortest paths to the nearest tree vertex, returns the added length*/
+DISTANCE_T connect_terminals(
+   steiner_instance const & instance,
+   std::vector<bool> & in_tree,
+   std::vector<std::pair<size_t, size_t> > & edges);
+
+/*Larger of the bounding box bound and the longest optimal tree of the vertex and three remaining terminals,
+a search with this bound computes the optima of the terminal pairs and triples once and keeps them*/
+DISTANCE_T small_subset_lower_bound(BITSET terminal_key, size_t vertex, steiner_instance const & instance);
+
 #endif
@@ -0,0 +1,665 @@
+/*******************************************************************************
+ * Copyright (c) 2019 Paul Stahr
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ ******************************************************************************/
+
+#include <vector>
+#include <algorithm>
+#include <atomic>
+#include <queue>
+#include <unordered_map>
+#include <stdexcept>
+#include <limits>
+#include <cerrno>
+#include <cstring>
+#include <functional>
+#include <numeric>
+#include <chrono>
+#include <sched.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "distributed_steiner.h"
+#include "phase_trace.h"
+
+/*Messages per ring between two processes, a full ring leaves the messages in the outbox of the sender*/
+static const size_t distributed_ring_capacity = size_t(1) << 12;
+
+/*Labels a worker extracts before it looks at its rings again*/
+static const size_t distributed_extraction_batch = 64;
+
+static const size_t no_vertex = std::numeric_limits<size_t>::max();
+static const uint64_t no_key = std::numeric_limits<uint64_t>::max();
+
+static_assert(ATOMIC_LLONG_LOCK_FREE == 2, "Counters in shared memory have to be lock free");
+
+enum distributed_message_type : uint8_t {CANDIDATE_MESSAGE, TRACK_REQUEST_MESSAGE, TRACK_REPLY_MESSAGE, EXIT_MESSAGE};
+
+struct distributed_message{
+   distributed_message_type _type;
+   size_t _v;
+   BITSET _terminal_key;
+   DISTANCE_T _steinerlength;
+   size_t _prev_v[2];                      /*no_vertex for labels of single terminals, both equal for relaxations*/
+   BITSET _prev_key[2];
+};
+
+/*Single producer single consumer ring in shared memory*/
+struct message_ring{
+   alignas(64) std::atomic<size_t> _head;  /*next slot to read, only written by the receiver*/
+   alignas(64) std::atomic<size_t> _tail;  /*next slot to write, only written by the sender*/
+   distributed_message _slots[distributed_ring_capacity];
+
+   message_ring() : _head(0), _tail(0){}
+
+   bool push(distributed_message const & message)
+   {
+      size_t tail = _tail.load(std::memory_order_relaxed);
+      if (tail - _head.load(std::memory_order_acquire) == distributed_ring_capacity)
+      {
+         return false;
+      }
+      _slots[tail % distributed_ring_capacity] = message;
+      _tail.store(tail + 1, std::memory_order_release);
+      return true;
+   }
+
+   bool pop(distributed_message & message)
+   {
+      size_t head = _head.load(std::memory_order_relaxed);
+      if (head == _tail.load(std::memory_order_acquire))
+      {
+         return false;
+      }
+      message = _slots[head % distributed_ring_capacity];
+      _head.store(head + 1, std::memory_order_release);
+      return true;
+   }
+};
+
+/*State of a worker read by the coordinator to detect termination*/
+struct alignas(64) worker_counters{
+   std::atomic<uint64_t> _sent;            /*candidates for other workers, counted when they enter the outbox*/
+   std::atomic<uint64_t> _received;        /*candidates from other workers, counted after the smallest key including them was published*/
+   std::atomic<uint64_t> _min_key;         /*smallest key of the open labels, no_key without any and 0 before the worker seeded its labels*/
+   std::atomic<uint64_t> _extracted;
+   std::atomic<bool> _failed;
+
+   worker_counters() : _sent(0), _received(0), _min_key(0), _extracted(0), _failed(false){}
+};
+
+struct alignas(64) distributed_shared{
+   std::atomic<uint64_t> _incumbent;       /*length of the best tree of all terminals found so far, no_key before the first*/
+   std::atomic<uint64_t> _extracted;       /*labels extracted by all workers, counted against the label limit*/
+   std::atomic<bool> _terminate;
+
+   distributed_shared() : _incumbent(no_key), _extracted(0), _terminate(false){}
+};
+
+struct distributed_context{
+   DISTANCE_T (*_lower_bound)(BITSET terminal_key, size_t vertex, steiner_instance const &);
+   steiner_instance const & _instance;
+   size_t _num_workers;
+   size_t _num_keyed_terminals;
+   BITSET _all_terminal_key;
+   size_t _root;
+   size_t _label_limit;
+   distributed_shared *_shared;
+   worker_counters *_counters;
+   message_ring *_rings;                   /*one ring for every ordered pair of workers and the coordinator, which has the last index*/
+
+   distributed_context(steiner_instance const & instance) : _instance(instance){}
+
+   message_ring & ring(size_t from, size_t to){return _rings[from * (_num_workers + 1) + to];}
+
+   /*Neighbouring grid vertices should go to different workers*/
+   size_t owner(size_t v) const{return ((v * 0x9E3779B97F4A7C15ull) >> 32) % _num_workers;}
+};
+
+struct distributed_label{
+   DISTANCE_T _steinerlength;
+   bool _open;
+   bool _listed;                           /*in the permanent keys of its vertex*/
+   size_t _prev_v[2];
+   BITSET _prev_key[2];
+};
+
+struct distributed_vertex{
+   std::unordered_map<BITSET, distributed_label> _labels;
+   std::vector<BITSET> _permanent;         /*labels extracted at least once, the partners of merges*/
+};
+
+struct open_label{
+   uint64_t _key;
+   DISTANCE_T _steinerlength;
+   size_t _v;
+   BITSET _terminal_key;
+
+   open_label(uint64_t key_, DISTANCE_T steinerlength_, size_t v_, BITSET terminal_key_) : _key(key_), _steinerlength(steinerlength_), _v(v_), _terminal_key(terminal_key_){}
+
+   bool operator>(open_label const & other) const{return _key > other._key;}
+};
+
+/*Search of the labels of the vertices owned by one worker process*/
+class DistributedWorker{
+public:
+   DistributedWorker(distributed_context & context, size_t id) : _context(context), _id(id), _counters(context._counters[id]), _outboxes(context._num_workers + 1){}
+
+   void run()
+   {
+      steiner_instance const & instance = _context._instance;
+      for (size_t i = 0; i < _context._num_keyed_terminals; ++i)
+      {
+         distributed_message seed = candidate_message(instance._terminals[i], BITSET(1) << i, 0, no_vertex, 0, no_vertex, 0);
+         if (_context.owner(seed._v) == _id)
+         {
+            apply(seed);
+         }
+      }
+      publish();
+      while (drain())
+      {
+         flush();
+         size_t num_extracted = 0;
+         if (!_context._shared->_terminate.load())
+         {
+            while (num_extracted < distributed_extraction_batch && !_context._shared->_terminate.load(std::memory_order_relaxed) && extract())
+            {
+               ++num_extracted;
+            }
+         }
+         publish();
+         flush();
+         if (num_extracted == 0)
+         {
+            sched_yield();
+         }
+      }
+   }
+
+private:
+   distributed_context & _context;
+   size_t _id;
+   worker_counters & _counters;
+   std::unordered_map<size_t, distributed_vertex> _vertices;
+   std::priority_queue<open_label, std::vector<open_label>, std::greater<open_label> > _open;
+   std::vector<std::vector<distributed_message> > _outboxes;
+
+   static distributed_message candidate_message(size_t v, BITSET terminal_key, DISTANCE_T steinerlength, size_t prev0_v, BITSET prev0_key, size_t prev1_v, BITSET prev1_key)
+   {
+      distributed_message message;
+      message._type = CANDIDATE_MESSAGE;
+      message._v = v;
+      message._terminal_key = terminal_key;
+      message._steinerlength = steinerlength;
+      message._prev_v[0] = prev0_v;
+      message._prev_key[0] = prev0_key;
+      message._prev_v[1] = prev1_v;
+      message._prev_key[1] = prev1_key;
+      return message;
+   }
+
+   /*Creates, improves or reopens the label of the candidate*/
+   void apply(distributed_message const & message)
+   {
+      distributed_vertex & current = _vertices[message._v];
+      auto existing = current._labels.find(message._terminal_key);
+      if (existing != current._labels.end() && existing->second._steinerlength <= message._steinerlength)
+      {
+         return;
+      }
+      uint64_t key = uint64_t(message._steinerlength) + _context._lower_bound(message._terminal_key, message._v, _context._instance);
+      if (key >= _context._shared->_incumbent.load(std::memory_order_relaxed))
+      {
+         return;
+      }
+      distributed_label & label = existing != current._labels.end() ? existing->second : current._labels[message._terminal_key];
+      if (existing == current._labels.end())
+      {
+         label._listed = false;
+      }
+      label._steinerlength = message._steinerlength;
+      label._open = true;
+      std::copy(message._prev_v, message._prev_v + 2, label._prev_v);
+      std::copy(message._prev_key, message._prev_key + 2, label._prev_key);
+      _open.emplace(key, message._steinerlength, message._v, message._terminal_key);
+   }
+
+   void send(distributed_message const & message)
+   {
+      size_t destination = _context.owner(message._v);
+      if (destination == _id)
+      {
+         apply(message);
+      }
+      else
+      {
+         _counters._sent.fetch_add(1);
+         _outboxes[destination].push_back(message);
+      }
+   }
+
+   /*Drops outdated heap entries, returns the label at the top or null*/
+   distributed_label *top()
+   {
+      while (!_open.empty())
+      {
+         open_label const & entry = _open.top();
+         distributed_label & label = _vertices[entry._v]._labels[entry._terminal_key];
+         if (label._open && label._steinerlength == entry._steinerlength)
+         {
+            return &label;
+         }
+         _open.pop();
+      }
+      return nullptr;
+   }
+
+   void publish()
+   {
+      _counters._min_key.store(top() == nullptr ? no_key : _open.top()._key);
+   }
+
+   bool extract()
+   {
+      distributed_label *label = top();
+      if (label == nullptr || _open.top()._key >= _context._shared->_incumbent.load())
+      {
+         return false;
+      }
+      if (_context._label_limit != 0 && _context._shared->_extracted.fetch_add(1, std::memory_order_relaxed) >= _context._label_limit)
+      {
+         _context._shared->_terminate = true;
+         return false;
+      }
+      open_label entry = _open.top();
+      _open.pop();
+      label->_open = false;
+      _counters._extracted.fetch_add(1, std::memory_order_relaxed);
+      size_t v = entry._v;
+      BITSET terminal_key = entry._terminal_key;
+      DISTANCE_T steinerlength = entry._steinerlength;
+      if (v == _context._root && terminal_key == _context._all_terminal_key)
+      {
+         uint64_t incumbent = _context._shared->_incumbent.load();
+         while (steinerlength < incumbent && !_context._shared->_incumbent.compare_exchange_weak(incumbent, steinerlength)){}
+         return true;
+      }
+      distributed_vertex & current = _vertices[v];
+      if (!label->_listed)
+      {
+         label->_listed = true;
+         current._permanent.push_back(terminal_key);
+      }
+      steiner_instance const & instance = _context._instance;
+      size_t num_keyed_terminals = _context._num_keyed_terminals;
+      for (neighbour const & n : instance._vertices[v]._neighbours)
+      {
+         uint8_t w_terminal_number = instance._vertices[n._vertex]._terminal_number;
+         BITSET w_terminal_key = terminal_key | (w_terminal_number < num_keyed_terminals ? BITSET(1) << w_terminal_number : 0);
+         send(candidate_message(n._vertex, w_terminal_key, steinerlength + n._distance, v, terminal_key, v, terminal_key));
+      }
+      /*Trees meeting in a terminal share it, so both keys may contain the terminal itself*/
+      uint8_t terminal_number = instance._vertices[v]._terminal_number;
+      BITSET own_terminal_key = terminal_number < num_keyed_terminals ? BITSET(1) << terminal_number : 0;
+      BITSET key = terminal_key & ~own_terminal_key;
+      for (size_t i = 0; i < current._permanent.size(); ++i)
+      {
+         BITSET p_terminal_key = current._permanent[i];
+         if ((p_terminal_key & key) != 0 || (p_terminal_key | terminal_key) == terminal_key)
+         {
+            continue;
+         }
+         DISTANCE_T p_steinerlength = current._labels[p_terminal_key]._steinerlength;
+         apply(candidate_message(v, terminal_key | p_terminal_key, steinerlength + p_steinerlength, v, terminal_key, v, p_terminal_key));
+      }
+      return true;
+   }
+
+   /*Handles the messages of all rings, returns false when the coordinator ends the worker*/
+   bool drain()
+   {
+      uint64_t num_received = 0;
+      for (size_t from = 0; from <= _context._num_workers; ++from)
+      {
+         message_ring & ring = _context.ring(from, _id);
+         distributed_message message;
+         while (ring.pop(message))
+         {
+            switch (message._type)
+            {
+               case CANDIDATE_MESSAGE:
+                  apply(message);
+                  ++num_received;
+                  break;
+               case TRACK_REQUEST_MESSAGE:
+               {
+                  distributed_label const & label = _vertices[message._v]._labels[message._terminal_key];
+                  message._type = TRACK_REPLY_MESSAGE;
+                  message._steinerlength = label._steinerlength;
+                  std::copy(label._prev_v, label._prev_v + 2, message._prev_v);
+                  std::copy(label._prev_key, label._prev_key + 2, message._prev_key);
+                  _outboxes[_context._num_workers].push_back(message);
+                  break;
+               }
+               case EXIT_MESSAGE:
+                  return false;
+               default:
+                  throw std::runtime_error("Unexpected message");
+            }
+         }
+      }
+      /*The coordinator has to see the keys of the received labels before it sees them as received*/
+      publish();
+      _counters._received.fetch_add(num_received);
+      return true;
+   }
+
+   void flush()
+   {
+      for (size_t to = 0; to <= _context._num_workers; ++to)
+      {
+         std::vector<distributed_message> & outbox = _outboxes[to];
+         message_ring & ring = _context.ring(_id, to);
+         size_t num_pushed = 0;
+         while (num_pushed < outbox.size() && ring.push(outbox[num_pushed]))
+         {
+            ++num_pushed;
+         }
+         outbox.erase(outbox.begin(), outbox.begin() + num_pushed);
+      }
+   }
+};
+
+/*Memory shared by the coordinator and the forked workers*/
+class SharedRegion{
+public:
+   explicit SharedRegion(size_t bytes) : _bytes(bytes)
+   {
+      _begin = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+      if (_begin == MAP_FAILED)
+      {
+         throw std::runtime_error(std::string("Can't map shared memory: ") + std::strerror(errno));
+      }
+   }
+
+   ~SharedRegion(){munmap(_begin, _bytes);}
+
+   char *begin() const{return static_cast<char*>(_begin);}
+
+private:
+   void *_begin;
+   size_t _bytes;
+
+   SharedRegion(SharedRegion const &) = delete;
+   SharedRegion & operator=(SharedRegion const &) = delete;
+};
+
+/*Kills the workers when the coordinator leaves with an exception*/
+static void stop_workers(std::vector<pid_t> & pids, bool kill_workers)
+{
+   for (pid_t pid : pids)
+   {
+      if (kill_workers)
+      {
+         kill(pid, SIGKILL);
+      }
+      waitpid(pid, nullptr, 0);
+   }
+   pids.clear();
+}
+
+DISTANCE_T calculate_steinertree_distributed(
+   DISTANCE_T (*lower_bound)(BITSET terminal_key, size_t vertex, steiner_instance const &),
+   steiner_instance const & instance,
+   dijkstra_steiner_settings const & settings,
+   std::vector<std::pair<size_t, size_t> > & edges)
+{
+   if (settings._memory_budget_bytes != 0 || settings._epsilon != 0 || settings._superset_dominance
+      || settings._statistics != nullptr || settings._memory_usage != nullptr || settings._progress_callback != nullptr)
+   {
+      throw std::invalid_argument("Distributed search doesn't support a memory budget, epsilon, dominance, statistics, memory usage or progress");
+   }
+   ScopedPhase phase(settings._trace, "distributed search");
+   std::chrono::steady_clock::time_point start_time = std::chrono::steady_clock::now();
+   size_t num_workers = settings._distributed_workers;
+   size_t num_terminals = instance._terminals.size();
+   for (size_t t : instance._terminals)
+   {
+      if (instance._vertices[t]._is_excluded)
+      {
+         throw std::runtime_error("Terminal marked as excluded");
+      }
+   }
+   size_t counters_offset = sizeof(distributed_shared);
+   size_t rings_offset = counters_offset + num_workers * sizeof(worker_counters);
+   SharedRegion region(rings_offset + (num_workers + 1) * (num_workers + 1) * sizeof(message_ring));
+   distributed_context context(instance);
+   context._lower_bound = lower_bound;
+   context._num_workers = num_workers;
+   /*t will be last terminal and is not part of any key*/
+   context._num_keyed_terminals = num_terminals - 1;
+   context._all_terminal_key = (BITSET(1) << (num_terminals - 1)) - 1;
+   context._root = instance._terminals.back();
+   context._label_limit = settings._label_limit;
+   context._shared = new (region.begin()) distributed_shared();
+   context._counters = reinterpret_cast<worker_counters*>(region.begin() + counters_offset);
+   context._rings = reinterpret_cast<message_ring*>(region.begin() + rings_offset);
+   for (size_t i = 0; i < num_workers; ++i)
+   {
+      new (context._counters + i) worker_counters();
+   }
+   for (size_t i = 0; i < (num_workers + 1) * (num_workers + 1); ++i)
+   {
+      new (context._rings + i) message_ring();
+   }
+
+   std::vector<pid_t> pids;
+   for (size_t i = 0; i < num_workers; ++i)
+   {
+      pid_t pid = fork();
+      if (pid == -1)
+      {
+         stop_workers(pids, true);
+         throw std::runtime_error(std::string("Can't fork worker: ") + std::strerror(errno));
+      }
+      if (pid == 0)
+      {
+         try
+         {
+            DistributedWorker(context, i).run();
+         }
+         catch (...)
+         {
+            context._counters[i]._failed = true;
+         }
+         _exit(0);
+      }
+      pids.push_back(pid);
+   }
+   auto check_workers = [&]()
+   {
+      for (size_t i = 0; i < num_workers; ++i)
+      {
+         if (context._counters[i]._failed || waitpid(pids[i], nullptr, WNOHANG) != 0)
+         {
+            stop_workers(pids, true);
+            throw std::runtime_error("Distributed worker failed");
+         }
+      }
+   };
+
+   /*Two waves of the same counters with as many candidates received as sent mean that nothing was in flight between them*/
+   std::vector<uint64_t> first_wave, second_wave;
+   auto read_wave = [&](std::vector<uint64_t> & wave)
+   {
+      wave.clear();
+      for (size_t i = 0; i < num_workers; ++i)
+      {
+         worker_counters const & counters = context._counters[i];
+         wave.push_back(counters._received.load());
+         wave.push_back(counters._min_key.load());
+         wave.push_back(counters._sent.load());
+      }
+   };
+   /*After a limit the workers only receive, so the waves settle without a bounded heap*/
+   bool limit_reached = false;
+   uint64_t incumbent;
+   while (true)
+   {
+      check_workers();
+      /*The workers stop themselves at the label limit*/
+      if (!limit_reached && (context._shared->_terminate.load() ||
+         (settings._time_limit_seconds != 0 && std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count() >= settings._time_limit_seconds)))
+      {
+         limit_reached = true;
+         context._shared->_terminate = true;
+      }
+      incumbent = context._shared->_incumbent.load();
+      read_wave(first_wave);
+      sched_yield();
+      read_wave(second_wave);
+      uint64_t sum_received = 0, sum_sent = 0;
+      bool bounded = true;
+      for (size_t i = 0; i < num_workers; ++i)
+      {
+         sum_received += second_wave[i * 3];
+         bounded &= second_wave[i * 3 + 1] >= incumbent;
+         sum_sent += second_wave[i * 3 + 2];
+      }
+      if (first_wave == second_wave && sum_received == sum_sent && (bounded || limit_reached))
+      {
+         break;
+      }
+   }
+   context._shared->_terminate = true;
+   /*Some label of an optimal tree is open with its optimal length, so with nothing in flight the smallest open key bounds the optimum from below*/
+   uint64_t min_key = incumbent;
+   for (size_t i = 0; i < num_workers; ++i)
+   {
+      min_key = std::min(min_key, second_wave[i * 3 + 1]);
+   }
+   if (incumbent == no_key && !limit_reached)
+   {
+      stop_workers(pids, true);
+      throw std::runtime_error("Empty heap");
+   }
+
+   DISTANCE_T length = 0;
+   if (incumbent != no_key)
+   {
+      phase.next("distributed track_back");
+      size_t first_edge = edges.size();
+      std::vector<std::pair<size_t, BITSET> > stack(1, std::make_pair(context._root, context._all_terminal_key));
+      while (!stack.empty())
+      {
+         size_t owner = context.owner(stack.back().first);
+         distributed_message message;
+         message._type = TRACK_REQUEST_MESSAGE;
+         message._v = stack.back().first;
+         message._terminal_key = stack.back().second;
+         stack.pop_back();
+         while (!context.ring(num_workers, owner).push(message))
+         {
+            check_workers();
+            sched_yield();
+         }
+         while (!context.ring(owner, num_workers).pop(message))
+         {
+            check_workers();
+            sched_yield();
+         }
+         if (message._prev_v[0] == no_vertex)
+         {
+         }
+         else if (message._prev_v[0] == message._prev_v[1] && message._prev_key[0] == message._prev_key[1])
+         {
+            edges.emplace_back(message._v, message._prev_v[0]);
+            stack.emplace_back(message._prev_v[0], message._prev_key[0]);
+         }
+         else
+         {
+            stack.emplace_back(message._prev_v[1], message._prev_key[1]);
+            stack.emplace_back(message._prev_v[0], message._prev_key[0]);
+         }
+      }
+      length = incumbent;
+      if (limit_reached)
+      {
+         /*Labels of the tree may have been shortened after it was found, their trees can overlap and close cycles*/
+         std::sort(edges.begin() + first_edge, edges.end());
+         edges.erase(std::unique(edges.begin() + first_edge, edges.end()), edges.end());
+         std::vector<size_t> parent(instance._vertices.size());
+         std::iota(parent.begin(), parent.end(), 0);
+         auto find_root = [&parent](size_t i)
+         {
+            while (parent[i] != i)
+            {
+               i = parent[i] = parent[parent[i]];
+            }
+            return i;
+         };
+         length = 0;
+         size_t num_kept = first_edge;
+         for (size_t i = first_edge; i < edges.size(); ++i)
+         {
+            std::pair<size_t, size_t> const e = edges[i];
+            size_t first_root = find_root(e.first);
+            size_t second_root = find_root(e.second);
+            if (first_root != second_root)
+            {
+               parent[first_root] = second_root;
+               std::vector<neighbour> const & neighbours = instance._vertices[e.first]._neighbours;
+               length += std::find_if(neighbours.begin(), neighbours.end(), [&e](neighbour const & n){return n._vertex == e.second;})->_distance;
+               edges[num_kept++] = e;
+            }
+         }
+         edges.resize(num_kept);
+      }
+   }
+
+   size_t num_extracted = 0;
+   for (size_t i = 0; i < num_workers; ++i)
+   {
+      distributed_message message;
+      message._type = EXIT_MESSAGE;
+      while (!context.ring(num_workers, i).push(message))
+      {
+         sched_yield();
+      }
+      num_extracted += context._counters[i]._extracted.load();
+   }
+   stop_workers(pids, false);
+   if (incumbent == no_key)
+   {
+      phase.next("complete partial tree");
+      std::vector<bool> in_tree(instance._vertices.size(), false);
+      in_tree[context._root] = true;
+      length = connect_terminals(instance, in_tree, edges);
+   }
+   if (settings._bounds != nullptr)
+   {
+      settings._bounds->_lower_bound = DISTANCE_T(std::min(min_key, uint64_t(length)));
+      settings._bounds->_upper_bound = length;
+      settings._bounds->_labels_extracted = num_extracted;
+   }
+   return length;
+}
@@ -0,0 +1,43 @@
+/*******************************************************************************
+ * Copyright (c) 2019 Paul Stahr
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ ******************************************************************************/
+
+#ifndef DISTRIBUTED_STEINER_H
+#define DISTRIBUTED_STEINER_H
+
+#include <vector>
+#include "util.h"
+#include "dijkstra_steiner.h"
+
+/*Labelling algorithm spread over _distributed_workers forked processes in the manner of hash distributed A*.
+Every vertex with all of its labels is owned by the worker its hash points to, so merges are local and only relaxations
+are sent in batches through shared memory rings. Labels are reopened when a shorter one arrives later,
+the search ends when no message is in flight and no worker has a label below the best tree of all terminals.
+The result is optimal unless the time or label limit stops the workers, then it is the best tree of all terminals found so far,
+or the terminals connected by shortest paths, and the smallest open key is the lower bound.
+Throws std::invalid_argument for the settings the workers don't implement*/
+DISTANCE_T calculate_steinertree_distributed(
+   DISTANCE_T (*lower_bound)(BITSET terminal_key, size_t vertex, steiner_instance const &),
+   steiner_instance const & instance,
+   dijkstra_steiner_settings const & settings,
+   std::vector<std::pair<size_t, size_t> > & edges);
+
+#endif
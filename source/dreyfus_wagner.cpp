@@ -0,0 +1,165 @@
+/*******************************************************************************
+ * Copyright (c) 2019 Paul Stahr
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ ******************************************************************************/
+
+#include <vector>
+#include <queue>
+#include <limits>
+#include <stdexcept>
+#include <functional>
+#include "dreyfus_wagner.h"
+
+DISTANCE_T calculate_steinertree_dreyfus_wagner(
+   steiner_instance const & instance,
+   std::vector<std::pair<size_t, size_t> > & edges)
+{
+   size_t num_vertices = instance._vertices.size();
+   size_t num_terminals = instance._terminals.size();
+   if (num_terminals <= 1)
+   {
+      return 0;
+   }
+   /*The last terminal is the root, subsets are keyed by the others*/
+   size_t num_keyed_terminals = num_terminals - 1;
+   if (num_keyed_terminals >= 32)
+   {
+      throw std::runtime_error("Too many terminals for subset dynamic program");
+   }
+   BITSET num_subsets = BITSET(1) << num_keyed_terminals;
+   DISTANCE_T const infinity = std::numeric_limits<DISTANCE_T>::max();
+   std::vector<DISTANCE_T> cost(num_subsets * num_vertices, infinity);
+
+   typedef std::pair<DISTANCE_T, size_t> queue_entry_t;
+   std::priority_queue<queue_entry_t, std::vector<queue_entry_t>, std::greater<queue_entry_t> > queue;
+   auto dijkstra = [&](DISTANCE_T *subset_cost)
+   {
+      for (size_t v = 0; v < num_vertices; ++v)
+      {
+         if (subset_cost[v] != infinity)
+         {
+            queue.emplace(subset_cost[v], v);
+         }
+      }
+      while (!queue.empty())
+      {
+         queue_entry_t current = queue.top();
+         queue.pop();
+         if (current.first != subset_cost[current.second])
+         {
+            continue;
+         }
+         for (neighbour const & n : instance._vertices[current.second]._neighbours)
+         {
+            DISTANCE_T length = current.first + n._distance;
+            if (length < subset_cost[n._vertex])
+            {
+               subset_cost[n._vertex] = length;
+               queue.emplace(length, n._vertex);
+            }
+         }
+      }
+   };
+
+   for (size_t i = 0; i < num_keyed_terminals; ++i)
+   {
+      DISTANCE_T *subset_cost = &cost[(BITSET(1) << i) * num_vertices];
+      subset_cost[instance._terminals[i]] = 0;
+      dijkstra(subset_cost);
+   }
+   for (BITSET subset = 1; subset < num_subsets; ++subset)
+   {
+      if ((subset & (subset - 1)) == 0)
+      {
+         continue;
+      }
+      DISTANCE_T *subset_cost = &cost[subset * num_vertices];
+      /*Every split is visited once by keeping the lowest terminal in the first part*/
+      BITSET lowest = subset & -subset;
+      for (BITSET part = (subset - 1) & subset; part != 0; part = (part - 1) & subset)
+      {
+         if (!(part & lowest))
+         {
+            continue;
+         }
+         DISTANCE_T const *part_cost = &cost[part * num_vertices];
+         DISTANCE_T const *rest_cost = &cost[(subset ^ part) * num_vertices];
+         for (size_t v = 0; v < num_vertices; ++v)
+         {
+            if (part_cost[v] != infinity && rest_cost[v] != infinity)
+            {
+               subset_cost[v] = std::min(subset_cost[v], part_cost[v] + rest_cost[v]);
+            }
+         }
+      }
+      dijkstra(subset_cost);
+   }
+
+   BITSET all_terminal_key = num_subsets - 1;
+   size_t root = instance._terminals.back();
+   DISTANCE_T length = cost[all_terminal_key * num_vertices + root];
+   if (length == infinity)
+   {
+      throw std::runtime_error("Terminals are not connected");
+   }
+
+   /*Follow splits and edges whose costs add up back to the terminals*/
+   std::vector<std::pair<BITSET, size_t> > stack(1, std::make_pair(all_terminal_key, root));
+   while (!stack.empty())
+   {
+      BITSET subset = stack.back().first;
+      size_t v = stack.back().second;
+      stack.pop_back();
+      DISTANCE_T current_cost = cost[subset * num_vertices + v];
+      if ((subset & (subset - 1)) == 0 && instance._terminals[__builtin_ctzll(subset)] == v)
+      {
+         continue;
+      }
+      bool found = false;
+      BITSET lowest = subset & -subset;
+      for (BITSET part = (subset - 1) & subset; part != 0 && !found; part = (part - 1) & subset)
+      {
+         DISTANCE_T part_cost = cost[part * num_vertices + v];
+         DISTANCE_T rest_cost = cost[(subset ^ part) * num_vertices + v];
+         if ((part & lowest) && part_cost != infinity && rest_cost != infinity && part_cost + rest_cost == current_cost)
+         {
+            stack.emplace_back(part, v);
+            stack.emplace_back(subset ^ part, v);
+            found = true;
+         }
+      }
+      for (size_t i = 0; i < instance._vertices[v]._neighbours.size() && !found; ++i)
+      {
+         neighbour const & n = instance._vertices[v]._neighbours[i];
+         DISTANCE_T neighbour_cost = cost[subset * num_vertices + n._vertex];
+         if (neighbour_cost != infinity && neighbour_cost + n._distance == current_cost)
+         {
+            edges.emplace_back(v, n._vertex);
+            stack.emplace_back(subset, n._vertex);
+            found = true;
+         }
+      }
+      if (!found)
+      {
+         throw std::runtime_error("Inconsistent subset table");
+      }
+   }
+   return length;
+}
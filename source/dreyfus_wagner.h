@@ -0,0 +1,36 @@
+/*******************************************************************************
+ * Copyright (c) 2019 Paul Stahr
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ ******************************************************************************/
+
+#ifndef DREYFUS_WAGNER_H
+#define DREYFUS_WAGNER_H
+
+#include <vector>
+#include "util.h"
+
+/*Dreyfus-Wagner subset dynamic program in the form of Erickson, Monma and Veinott: every subset of the terminals is
+combined from two of its subsets in each vertex and then extended by one Dijkstra run. Needs 3^k |V| + 2^k Dijkstra
+time and 2^k |V| memory and serves as an independent reference for the labelling algorithm*/
+DISTANCE_T calculate_steinertree_dreyfus_wagner(
+   steiner_instance const & instance,
+   std::vector<std::pair<size_t, size_t> > & edges);
+
+#endif
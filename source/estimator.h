@@ -0,0 +1,72 @@
+/*******************************************************************************
+ * Copyright (c) 2019 Paul Stahr
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ ******************************************************************************/
+
+#ifndef ESTIMATOR_H
+#define ESTIMATOR_H
+
+#include <vector>
+#include "util.h"
+#include "dijkstra_steiner.h"
+
+/*Features of a graph instance for predicting the cost of its search, the sampled search costs about as much as sample_labels extractions*/
+struct estimator_features{
+   size_t _num_terminals;
+   size_t _num_vertices;                   /*vertices not excluded by mark_excluded_vertices*/
+   DISTANCE_T _lower_bound;                /*bound of the search before the first extraction*/
+   DISTANCE_T _upper_bound;                /*length of a rectilinear minimum spanning tree of the terminals*/
+   size_t _sample_labels;                  /*labels extracted by the sampled search*/
+   DISTANCE_T _sample_lower_bound;         /*bound certified by the sampled search*/
+   bool _sample_finished;                  /*the sampled search already found the optimum*/
+   double _sample_seconds;
+   size_t _sample_peak_bytes;
+};
+
+/*Predicted or measured cost of a search*/
+struct estimator_prediction{
+   double _labels;
+   double _seconds;
+   double _peak_bytes;
+};
+
+/*log(labels) is linear in the logarithm of the extrapolated sample, the number of terminals, the logarithm of the grid size
+and the relative gap between the bounds. Seconds scale the labels by the rate of the sample, bytes grow linearly with the labels*/
+struct estimator_model{
+   double _label_coefficients[5];
+   double _seconds_factor;
+   double _bytes_per_label;
+
+   estimator_model();                      /*the model fitted by benchmark --calibrate*/
+};
+
+void compute_estimator_features(
+   DISTANCE_T (*lower_bound)(BITSET terminal_key, size_t vertex, steiner_instance const &),
+   steiner_instance const & instance,
+   dijkstra_steiner_settings const & settings,
+   size_t sample_labels,
+   estimator_features & features);
+
+void estimate_resources(estimator_features const & features, estimator_model const & model, estimator_prediction & prediction);
+
+/*Least squares fit of the model to the measured searches of instances with the given features*/
+void fit_estimator_model(std::vector<estimator_features> const & features, std::vector<estimator_prediction> const & measured, estimator_model & model);
+
+#endif
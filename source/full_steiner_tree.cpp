@@ -0,0 +1,886 @@
+/*******************************************************************************
+ * Copyright (c) 2019 Paul Stahr
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ ******************************************************************************/
+
+#include <vector>
+#include <algorithm>
+#include <exception>
+#include <stdexcept>
+#include <limits>
+#include <cmath>
+#include <numeric>
+#include <unordered_map>
+#include <chrono>
+#include "util.h"
+#include "dijkstra_steiner.h"
+#include "full_steiner_tree.h"
+#include "phase_trace.h"
+
+static DISTANCE_T manhattan_distance(std::vector<COOR> const & a, std::vector<COOR> const & b)
+{
+   DISTANCE_T dist = 0;
+   for (size_t i = 0; i < a.size(); ++i)
+   {
+      dist += std::abs(a[i] - b[i]);
+   }
+   return dist;
+}
+
+/*The bottleneck steiner distance of two terminals is the longest edge on their path in a minimum spanning tree*/
+static void bottleneck_distances(std::vector<std::vector <COOR> > const & terminals, std::vector<DISTANCE_T> & bottleneck)
+{
+   size_t num_terminals = terminals.size();
+   std::vector<std::vector<std::pair<size_t, DISTANCE_T> > > tree(num_terminals);
+   std::vector<DISTANCE_T> best(num_terminals, std::numeric_limits<DISTANCE_T>::max());
+   std::vector<size_t> parent(num_terminals, 0);
+   std::vector<bool> in_tree(num_terminals, false);
+   for (size_t i = 0; i < num_terminals; ++i)
+   {
+      size_t next = std::numeric_limits<size_t>::max();
+      for (size_t j = 0; j < num_terminals; ++j)
+      {
+         if (!in_tree[j] && (next == std::numeric_limits<size_t>::max() || best[j] < best[next]))
+         {
+            next = j;
+         }
+      }
+      in_tree[next] = true;
+      if (i != 0)
+      {
+         tree[next].emplace_back(parent[next], best[next]);
+         tree[parent[next]].emplace_back(next, best[next]);
+      }
+      for (size_t j = 0; j < num_terminals; ++j)
+      {
+         DISTANCE_T dist = manhattan_distance(terminals[next], terminals[j]);
+         if (!in_tree[j] && dist < best[j])
+         {
+            best[j] = dist;
+            parent[j] = next;
+         }
+      }
+   }
+   bottleneck.assign(num_terminals * num_terminals, 0);
+   std::vector<size_t> stack;
+   std::vector<bool> visited;
+   for (size_t i = 0; i < num_terminals; ++i)
+   {
+      DISTANCE_T *row = &bottleneck[i * num_terminals];
+      visited.assign(num_terminals, false);
+      visited[i] = true;
+      stack.push_back(i);
+      while (!stack.empty())
+      {
+         size_t v = stack.back();
+         stack.pop_back();
+         for (std::pair<size_t, DISTANCE_T> const & e : tree[v])
+         {
+            if (!visited[e.first])
+            {
+               visited[e.first] = true;
+               row[e.first] = std::max(row[v], e.second);
+               stack.push_back(e.first);
+            }
+         }
+      }
+   }
+}
+
+/*A steiner minimal tree of three points is a star around their median*/
+static void median(std::vector<COOR> const & a, std::vector<COOR> const & b, std::vector<COOR> const & c, std::vector<COOR> & m)
+{
+   m.resize(a.size());
+   for (size_t i = 0; i < a.size(); ++i)
+   {
+      m[i] = std::max(std::min(a[i], b[i]), std::min(std::max(a[i], b[i]), c[i]));
+   }
+}
+
+static DISTANCE_T bottleneck_spanning_tree_length(std::vector<DISTANCE_T> const & bottleneck, size_t num_terminals, BITSET terminal_key)
+{
+   std::vector<size_t> members;
+   for (BITSET key = terminal_key; key != 0; key &= key - 1)
+   {
+      members.push_back(__builtin_ctzll(key));
+   }
+   std::vector<DISTANCE_T> best(members.size(), std::numeric_limits<DISTANCE_T>::max());
+   std::vector<bool> in_tree(members.size(), false);
+   DISTANCE_T length = 0;
+   best[0] = 0;
+   for (size_t i = 0; i < members.size(); ++i)
+   {
+      size_t next = std::numeric_limits<size_t>::max();
+      for (size_t j = 0; j < members.size(); ++j)
+      {
+         if (!in_tree[j] && (next == std::numeric_limits<size_t>::max() || best[j] < best[next]))
+         {
+            next = j;
+         }
+      }
+      in_tree[next] = true;
+      length += best[next];
+      for (size_t j = 0; j < members.size(); ++j)
+      {
+         best[j] = std::min(best[j], bottleneck[members[next] * num_terminals + members[j]]);
+      }
+   }
+   return length;
+}
+
+/*Grows trees in Hwang's form from a terminal at one end of the backbone, the terminals are added in the order of their position along the backbone.
+All but the last two terminals are attached by straight legs to the backbone, the last two join the end of the backbone in a steiner tree of three points*/
+struct hwang_generator{
+   std::vector<std::vector <COOR> > const & _terminals;
+   std::vector<DISTANCE_T> const & _bottleneck;
+   DISTANCE_T _maximal_bottleneck;
+   uint8_t _axis;
+   std::vector<size_t> _candidates;
+   std::vector<size_t> _members;
+   std::unordered_map<BITSET, full_steiner_tree> & _trees;
+   full_steiner_tree_limits & _limits;
+
+   hwang_generator(
+      std::vector<std::vector <COOR> > const & terminals_,
+      std::vector<DISTANCE_T> const & bottleneck_,
+      std::unordered_map<BITSET, full_steiner_tree> & trees_,
+      full_steiner_tree_limits & limits_) : _terminals(terminals_), _bottleneck(bottleneck_), _trees(trees_), _limits(limits_)
+   {
+      _maximal_bottleneck = *std::max_element(_bottleneck.begin(), _bottleneck.end());
+   }
+
+   void backbone_end(std::vector<COOR> & end) const
+   {
+      end = _terminals[_members[0]];
+      end[_axis] = _terminals[_members[_members.size() < 3 ? 0 : _members.size() - 3]][_axis];
+   }
+
+   void add_tree(BITSET terminal_key)
+   {
+      size_t num_members = _members.size();
+      size_t last = _members[num_members - 1];
+      size_t second_last = _members[num_members < 3 ? num_members - 1 : num_members - 2];
+      std::vector<COOR> end;
+      backbone_end(end);
+      std::vector<COOR> center;
+      median(end, _terminals[second_last], _terminals[last], center);
+      /*A tree in which a terminal isn't a leaf is a concatenation of smaller ones*/
+      if (num_members > 2 && (center == _terminals[second_last] || center == _terminals[last]))
+      {
+         return;
+      }
+      DISTANCE_T length = std::abs(end[_axis] - _terminals[_members[0]][_axis]);
+      for (size_t i = 1; i + 2 < num_members; ++i)
+      {
+         length += std::abs(_terminals[_members[i]][1 - _axis] - end[1 - _axis]);
+      }
+      length += manhattan_distance(center, end) + manhattan_distance(center, _terminals[second_last]) + manhattan_distance(center, _terminals[last]);
+      full_steiner_tree & fst = _trees.emplace(terminal_key, full_steiner_tree()).first->second;
+      if (fst._terminal_key == 0 || length < fst._length)
+      {
+         fst._terminal_key = terminal_key;
+         fst._length = length;
+         fst._axis = _axis;
+         fst._first = _members[0];
+         fst._last[0] = second_last;
+         fst._last[1] = last;
+      }
+   }
+
+   /*A terminal closer to both ends of a segment than they are to each other would shorten the tree*/
+   bool is_empty_lune(std::vector<COOR> const & a, std::vector<COOR> const & b) const
+   {
+      DISTANCE_T length = manhattan_distance(a, b);
+      for (std::vector<COOR> const & t : _terminals)
+      {
+         if (manhattan_distance(t, a) < length && manhattan_distance(t, b) < length)
+         {
+            return false;
+         }
+      }
+      return true;
+   }
+
+   /*No edge of a steiner minimal tree is longer than the bottleneck distance of two terminals it separates*/
+   bool is_valid() const
+   {
+      size_t num_terminals = _terminals.size();
+      size_t num_members = _members.size();
+      size_t num_straight = num_members < 3 ? 1 : num_members - 2;
+      COOR backbone = _terminals[_members[0]][1 - _axis];
+      for (size_t i = 1; i < num_straight; ++i)
+      {
+         DISTANCE_T const *bottleneck = &_bottleneck[_members[i] * num_terminals];
+         DISTANCE_T leg = std::abs(_terminals[_members[i]][1 - _axis] - backbone);
+         for (size_t j = 0; j < num_members; ++j)
+         {
+            if (j != i && leg > bottleneck[_members[j]])
+            {
+               return false;
+            }
+         }
+      }
+      if (num_members > 3)
+      {
+         /*Only the leg turning straight is new, the other segments have been tested before*/
+         size_t i = num_straight - 1;
+         std::vector<COOR> foot(2);
+         foot[_axis] = _terminals[_members[i]][_axis];
+         foot[1 - _axis] = backbone;
+         std::vector<COOR> previous_foot(foot);
+         previous_foot[_axis] = _terminals[_members[i - 1]][_axis];
+         /*A terminal on the backbone has two edges and splits the tree*/
+         if (foot == _terminals[_members[i]] || !is_empty_lune(_terminals[_members[i]], foot) || !is_empty_lune(previous_foot, foot))
+         {
+            return false;
+         }
+      }
+      for (size_t i = 1; i < num_straight; ++i)
+      {
+         DISTANCE_T gap = std::abs(_terminals[_members[i]][_axis] - _terminals[_members[i - 1]][_axis]);
+         for (size_t j = 0; j < i; ++j)
+         {
+            DISTANCE_T const *bottleneck = &_bottleneck[_members[j] * num_terminals];
+            for (size_t l = i; l < num_members; ++l)
+            {
+               if (gap > bottleneck[_members[l]])
+               {
+                  return false;
+               }
+            }
+         }
+      }
+      return true;
+   }
+
+   void grow(size_t first_candidate, BITSET terminal_key)
+   {
+      /*The last terminals are connected to the last straight leg by at most two edges*/
+      COOR last_position = _terminals[_members[_members.size() < 2 ? 0 : _members.size() - 2]][_axis];
+      for (size_t c = first_candidate; c < _candidates.size(); ++c)
+      {
+         /*A step is cheap, so the clock is read only every few*/
+         if (_limits._reached || _limits.step(1024))
+         {
+            return;
+         }
+         size_t w = _candidates[c];
+         if (std::abs(_terminals[w][_axis] - last_position) > 2 * _maximal_bottleneck)
+         {
+            break;
+         }
+         _members.push_back(w);
+         if (is_valid())
+         {
+            BITSET key = terminal_key | (BITSET(1) << w);
+            add_tree(key);
+            grow(c + 1, key);
+         }
+         _members.pop_back();
+      }
+   }
+};
+
+bool generate_full_steiner_trees(std::vector<std::vector <COOR> > const & terminals, full_steiner_tree_limits & limits, std::vector<full_steiner_tree> & trees)
+{
+   size_t num_terminals = terminals.size();
+   if (num_terminals > std::numeric_limits<BITSET>::digits)
+   {
+      throw std::runtime_error("Too many terminals");
+   }
+   trees.clear();
+   std::vector<DISTANCE_T> bottleneck;
+   bottleneck_distances(terminals, bottleneck);
+   std::unordered_map<BITSET, full_steiner_tree> shortest_trees;
+   hwang_generator generator(terminals, bottleneck, shortest_trees, limits);
+   for (uint8_t axis = 0; axis < 2; ++axis)
+   {
+      generator._axis = axis;
+      for (int direction = -1; direction <= 1; direction += 2)
+      {
+         for (size_t i = 0; i < num_terminals && !limits._reached; ++i)
+         {
+            COOR position = terminals[i][axis];
+            generator._candidates.clear();
+            for (size_t j = 0; j < num_terminals; ++j)
+            {
+               if (j != i && (terminals[j][axis] - position) * direction >= 0)
+               {
+                  generator._candidates.push_back(j);
+               }
+            }
+            std::sort(generator._candidates.begin(), generator._candidates.end(), [&](size_t a, size_t b){
+               return std::abs(terminals[a][axis] - position) < std::abs(terminals[b][axis] - position)
+                  || (terminals[a][axis] == terminals[b][axis] && a < b);
+            });
+            generator._members.assign(1, i);
+            generator.grow(0, BITSET(1) << i);
+         }
+      }
+   }
+   if (limits._reached)
+   {
+      return false;
+   }
+   /*A tree longer than the bottleneck spanning tree of its terminals can be replaced by shorter ones*/
+   for (std::pair<BITSET const, full_steiner_tree> const & fst : shortest_trees)
+   {
+      if (fst.second._length <= bottleneck_spanning_tree_length(bottleneck, num_terminals, fst.first))
+      {
+         trees.push_back(fst.second);
+      }
+   }
+   std::sort(trees.begin(), trees.end(), [](full_steiner_tree const & a, full_steiner_tree const & b){return a._terminal_key < b._terminal_key;});
+   return true;
+}
+
+/*Minimum spanning tree of the terminals as trees of two terminals, each drawn with one bend*/
+static void spanning_tree_pairs(std::vector<std::vector <COOR> > const & terminals, std::vector<full_steiner_tree> & trees)
+{
+   size_t num_terminals = terminals.size();
+   std::vector<DISTANCE_T> distance(num_terminals, std::numeric_limits<DISTANCE_T>::max());
+   std::vector<size_t> nearest(num_terminals, 0);
+   std::vector<bool> connected(num_terminals, false);
+   trees.clear();
+   distance[0] = 0;
+   for (size_t i = 0; i < num_terminals; ++i)
+   {
+      size_t next = std::numeric_limits<size_t>::max();
+      for (size_t j = 0; j < num_terminals; ++j)
+      {
+         if (!connected[j] && (next == std::numeric_limits<size_t>::max() || distance[j] < distance[next]))
+         {
+            next = j;
+         }
+      }
+      connected[next] = true;
+      if (i != 0)
+      {
+         full_steiner_tree fst;
+         fst._terminal_key = (BITSET(1) << next) | (BITSET(1) << nearest[next]);
+         fst._length = distance[next];
+         fst._first = nearest[next];
+         fst._last[0] = fst._last[1] = next;
+         trees.push_back(fst);
+      }
+      for (size_t j = 0; j < num_terminals; ++j)
+      {
+         DISTANCE_T d = manhattan_distance(terminals[next], terminals[j]);
+         if (!connected[j] && d < distance[j])
+         {
+            distance[j] = d;
+            nearest[j] = next;
+         }
+      }
+   }
+}
+
+static size_t find_root(std::vector<size_t> & parent, size_t i)
+{
+   while (parent[i] != i)
+   {
+      parent[i] = parent[parent[i]];
+      i = parent[i];
+   }
+   return i;
+}
+
+/*Dense dual simplex for min c x subject to rows a x <= b and x >= 0 with nonnegative costs.
+The slack basis is dual feasible, so rows can be added at any time and the objective is always a lower bound*/
+struct concatenation_lp{
+   std::vector<std::vector<double> > _rows;
+   std::vector<double> _rhs;
+   std::vector<double> _reduced_costs;
+   std::vector<size_t> _basis;
+   double _objective;
+   size_t _num_trees;
+
+   concatenation_lp(std::vector<full_steiner_tree> const & trees) : _objective(0), _num_trees(trees.size())
+   {
+      for (full_steiner_tree const & fst : trees)
+      {
+         _reduced_costs.push_back(fst._length);
+      }
+   }
+
+   void add_row(std::vector<double> const & coefficients, double rhs)
+   {
+      size_t num_columns = _reduced_costs.size();
+      for (std::vector<double> & row : _rows)
+      {
+         row.push_back(0);
+      }
+      _reduced_costs.push_back(0);
+      std::vector<double> row(coefficients);
+      row.resize(num_columns + 1, 0);
+      row[num_columns] = 1;
+      /*Express the row in the current basis*/
+      for (size_t i = 0; i < _rows.size(); ++i)
+      {
+         double factor = _basis[i] < _num_trees ? coefficients[_basis[i]] : 0;
+         if (factor != 0)
+         {
+            std::vector<double> const & basis_row = _rows[i];
+            for (size_t j = 0; j < num_columns; ++j)
+            {
+               row[j] -= factor * basis_row[j];
+            }
+            rhs -= factor * _rhs[i];
+         }
+      }
+      _rows.push_back(row);
+      _rhs.push_back(rhs);
+      _basis.push_back(num_columns);
+   }
+
+   void pivot(size_t r, size_t c)
+   {
+      std::vector<double> & pivot_row = _rows[r];
+      double p = pivot_row[c];
+      for (double & value : pivot_row)
+      {
+         value /= p;
+      }
+      _rhs[r] /= p;
+      for (size_t i = 0; i < _rows.size(); ++i)
+      {
+         double factor = _rows[i][c];
+         if (i != r && factor != 0)
+         {
+            std::vector<double> & row = _rows[i];
+            for (size_t j = 0; j < row.size(); ++j)
+            {
+               row[j] -= factor * pivot_row[j];
+            }
+            _rhs[i] -= factor * _rhs[r];
+         }
+      }
+      double factor = _reduced_costs[c];
+      for (size_t j = 0; j < _reduced_costs.size(); ++j)
+      {
+         _reduced_costs[j] = std::max(_reduced_costs[j] - factor * pivot_row[j], 0.);
+      }
+      _reduced_costs[c] = 0;
+      _objective += factor * _rhs[r];
+      _basis[r] = c;
+   }
+
+   /*returns false if the relaxation is infeasible or its objective exceeds the cutoff*/
+   bool solve(double cutoff)
+   {
+      while (_objective <= cutoff)
+      {
+         size_t r = std::distance(_rhs.begin(), std::min_element(_rhs.begin(), _rhs.end()));
+         if (_rhs.empty() || _rhs[r] > -1e-9)
+         {
+            return true;
+         }
+         std::vector<double> const & row = _rows[r];
+         size_t c = std::numeric_limits<size_t>::max();
+         for (size_t j = 0; j < row.size(); ++j)
+         {
+            if (row[j] < -1e-9 && (c == std::numeric_limits<size_t>::max() || _reduced_costs[j] * -row[c] < _reduced_costs[c] * -row[j]))
+            {
+               c = j;
+            }
+         }
+         if (c == std::numeric_limits<size_t>::max())
+         {
+            return false;
+         }
+         pivot(r, c);
+      }
+      return false;
+   }
+
+   void solution(std::vector<double> & x) const
+   {
+      x.assign(_num_trees, 0);
+      for (size_t i = 0; i < _rows.size(); ++i)
+      {
+         if (_basis[i] < _num_trees)
+         {
+            x[_basis[i]] = _rhs[i];
+         }
+      }
+   }
+};
+
+/*Branch and cut over spanning trees of the hypergraph of full steiner trees, relaxed by the subtour elimination constraints*/
+struct concatenation_search{
+   std::vector<full_steiner_tree> const & _trees;
+   size_t _num_terminals;
+   std::vector<size_t> _best_selected;
+   DISTANCE_T _best_length;
+   full_steiner_tree_limits & _limits;
+   bool _root_solved;
+   DISTANCE_T _root_bound;                 /*relaxation of the root rounded up, a lower bound for every concatenation*/
+
+   concatenation_search(std::vector<full_steiner_tree> const & trees_, size_t num_terminals_, full_steiner_tree_limits & limits_) :
+      _trees(trees_), _num_terminals(num_terminals_), _best_length(std::numeric_limits<DISTANCE_T>::max()), _limits(limits_), _root_solved(false), _root_bound(0){}
+
+   /*A forest of the trees can join the terminals of s in at most |s|-1 ways*/
+   void add_subtour_row(concatenation_lp & lp, BITSET s) const
+   {
+      std::vector<double> coefficients(_trees.size());
+      for (size_t i = 0; i < _trees.size(); ++i)
+      {
+         coefficients[i] = std::max(__builtin_popcountll(_trees[i]._terminal_key & s) - 1, 0);
+      }
+      lp.add_row(coefficients, __builtin_popcountll(s) - 1);
+   }
+
+   double subtour_activity(std::vector<size_t> const & support, std::vector<double> const & x, BITSET s) const
+   {
+      double activity = 0;
+      for (size_t i : support)
+      {
+         activity += std::max(__builtin_popcountll(_trees[i]._terminal_key & s) - 1, 0) * x[i];
+      }
+      return activity;
+   }
+
+   size_t find(std::vector<size_t> & parent, size_t i) const
+   {
+      while (parent[i] != i)
+      {
+         i = parent[i] = parent[parent[i]];
+      }
+      return i;
+   }
+
+   /*Joins the trees in the given order as long as they don't close a cycle, returns whether all terminals are connected*/
+   bool kruskal(std::vector<size_t> const & order, std::vector<size_t> & selected, DISTANCE_T & length) const
+   {
+      std::vector<size_t> parent(_num_terminals);
+      std::iota(parent.begin(), parent.end(), 0);
+      size_t num_components = _num_terminals;
+      selected.clear();
+      length = 0;
+      for (size_t i : order)
+      {
+         BITSET roots = 0;
+         bool cycle = false;
+         for (BITSET key = _trees[i]._terminal_key; key != 0 && !cycle; key &= key - 1)
+         {
+            BITSET bit = BITSET(1) << find(parent, __builtin_ctzll(key));
+            cycle = (roots & bit) != 0;
+            roots |= bit;
+         }
+         if (cycle)
+         {
+            continue;
+         }
+         size_t root = __builtin_ctzll(roots);
+         for (BITSET key = roots & (roots - 1); key != 0; key &= key - 1)
+         {
+            parent[__builtin_ctzll(key)] = root;
+         }
+         num_components -= __builtin_popcountll(roots) - 1;
+         selected.push_back(i);
+         length += _trees[i]._length;
+      }
+      return num_components == 1;
+   }
+
+   /*Rounds the relaxation by preferring trees with large values*/
+   void update_upper_bound(std::vector<double> const & x)
+   {
+      std::vector<size_t> order(_trees.size());
+      std::iota(order.begin(), order.end(), 0);
+      std::sort(order.begin(), order.end(), [&](size_t a, size_t b){
+         double ratio_a = static_cast<double>(_trees[a]._length) / (__builtin_popcountll(_trees[a]._terminal_key) - 1);
+         double ratio_b = static_cast<double>(_trees[b]._length) / (__builtin_popcountll(_trees[b]._terminal_key) - 1);
+         return x[a] > x[b] || (x[a] == x[b] && ratio_a < ratio_b);
+      });
+      std::vector<size_t> selected;
+      DISTANCE_T length;
+      if (kruskal(order, selected, length) && length < _best_length)
+      {
+         _best_length = length;
+         _best_selected = selected;
+      }
+   }
+
+   /*Adds violated subtour constraints of the components that arise while joining the support*/
+   size_t separate(concatenation_lp & lp, std::vector<double> const & x) const
+   {
+      std::vector<size_t> support;
+      for (size_t i = 0; i < _trees.size(); ++i)
+      {
+         if (x[i] > 1e-9)
+         {
+            support.push_back(i);
+         }
+      }
+      std::sort(support.begin(), support.end(), [&](size_t a, size_t b){return x[a] > x[b];});
+      std::vector<BITSET> cuts;
+      for (size_t i = 0; i < support.size(); ++i)
+      {
+         for (size_t j = i + 1; j < support.size(); ++j)
+         {
+            BITSET s = _trees[support[i]]._terminal_key & _trees[support[j]]._terminal_key;
+            if (__builtin_popcountll(s) > 1 && subtour_activity(support, x, s) > __builtin_popcountll(s) - 1 + 1e-6)
+            {
+               cuts.push_back(s);
+            }
+         }
+      }
+      std::vector<BITSET> members(_num_terminals);
+      for (size_t t = 0; t < _num_terminals; ++t)
+      {
+         members[t] = BITSET(1) << t;
+      }
+      std::vector<size_t> parent(_num_terminals);
+      std::iota(parent.begin(), parent.end(), 0);
+      for (size_t i : support)
+      {
+         size_t root = find(parent, __builtin_ctzll(_trees[i]._terminal_key));
+         for (BITSET key = _trees[i]._terminal_key; key != 0; key &= key - 1)
+         {
+            size_t other = find(parent, __builtin_ctzll(key));
+            if (other != root)
+            {
+               parent[other] = root;
+               members[root] |= members[other];
+            }
+         }
+         BITSET s = members[root];
+         if (subtour_activity(support, x, s) > __builtin_popcountll(s) - 1 + 1e-6)
+         {
+            cuts.push_back(s);
+         }
+      }
+      std::sort(cuts.begin(), cuts.end());
+      cuts.erase(std::unique(cuts.begin(), cuts.end()), cuts.end());
+      for (BITSET s : cuts)
+      {
+         add_subtour_row(lp, s);
+      }
+      return cuts.size();
+   }
+
+   void search(concatenation_lp & lp)
+   {
+      std::vector<double> x;
+      do
+      {
+         if (_limits.step(1))
+         {
+            return;
+         }
+         /*Lengths are integral, so the relaxation has to beat the best tree by at least one*/
+         if (!lp.solve(_best_length - 1 + 1e-6))
+         {
+            return;
+         }
+         lp.solution(x);
+      } while (separate(lp, x) != 0);
+      if (!_root_solved)
+      {
+         _root_solved = true;
+         _root_bound = DISTANCE_T(std::ceil(lp._objective - 1e-6));
+      }
+      update_upper_bound(x);
+      size_t branch = std::numeric_limits<size_t>::max();
+      for (size_t i = 0; i < x.size(); ++i)
+      {
+         if (x[i] > 1e-6 && x[i] < 1 - 1e-6 && (branch == std::numeric_limits<size_t>::max() || x[i] > x[branch]))
+         {
+            branch = i;
+         }
+      }
+      if (branch == std::numeric_limits<size_t>::max())
+      {
+         return;
+      }
+      std::vector<double> coefficients(_trees.size(), 0);
+      {
+         concatenation_lp child(lp);
+         coefficients[branch] = -1;
+         child.add_row(coefficients, -1);
+         search(child);
+      }
+      if (_limits._reached)
+      {
+         return;
+      }
+      coefficients[branch] = 1;
+      lp.add_row(coefficients, 0);
+      search(lp);
+   }
+};
+
+DISTANCE_T concatenate_full_steiner_trees(
+   std::vector<full_steiner_tree> const & trees,
+   size_t num_terminals,
+   full_steiner_tree_limits & limits,
+   std::vector<size_t> & selected,
+   DISTANCE_T & lower_bound)
+{
+   concatenation_search concatenation(trees, num_terminals, limits);
+   concatenation_lp lp(trees);
+   std::vector<double> coefficients(trees.size());
+   for (size_t i = 0; i < trees.size(); ++i)
+   {
+      coefficients[i] = __builtin_popcountll(trees[i]._terminal_key) - 1;
+   }
+   lp.add_row(coefficients, num_terminals - 1);
+   for (double & c : coefficients)
+   {
+      c = -c;
+   }
+   lp.add_row(coefficients, -static_cast<double>(num_terminals - 1));
+   BITSET all = num_terminals == std::numeric_limits<BITSET>::digits ? ~BITSET(0) : (BITSET(1) << num_terminals) - 1;
+   for (size_t t = 0; t < num_terminals; ++t)
+   {
+      concatenation.add_subtour_row(lp, all ^ (BITSET(1) << t));
+   }
+   concatenation.search(lp);
+   if (concatenation._best_length == std::numeric_limits<DISTANCE_T>::max() && !limits._reached)
+   {
+      throw std::runtime_error("Full steiner trees don't span the terminals");
+   }
+   selected = concatenation._best_selected;
+   lower_bound = limits._reached ? std::min(concatenation._root_bound, concatenation._best_length) : concatenation._best_length;
+   return concatenation._best_length;
+}
+
+DISTANCE_T calculate_steinertree_full_steiner_trees(
+   std::vector<std::vector <COOR> > const & terminals,
+   dijkstra_steiner_settings const & settings,
+   std::vector<std::vector <COOR> > & steinerpoints,
+   std::vector<std::pair<size_t, size_t> > & edges)
+{
+   if (terminals[0].size() != 2)
+   {
+      throw std::runtime_error("Full steiner trees are only supported for two dimensions");
+   }
+   full_steiner_tree_limits limits;
+   if (settings._time_limit_seconds != 0)
+   {
+      limits._deadline = std::chrono::steady_clock::now() + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(settings._time_limit_seconds));
+   }
+   limits._step_limit = settings._label_limit;
+   size_t num_terminals = terminals.size();
+   std::vector<full_steiner_tree> trees;
+   std::vector<size_t> selected;
+   DISTANCE_T lower_bound = 0;
+   if (num_terminals > 1)
+   {
+      ScopedPhase phase(settings._trace, "full steiner tree generation");
+      if (generate_full_steiner_trees(terminals, limits, trees))
+      {
+         phase.next("full steiner tree concatenation");
+         concatenate_full_steiner_trees(trees, num_terminals, limits, selected, lower_bound);
+      }
+      if (selected.empty())
+      {
+         /*A limit was reached before any concatenation was found*/
+         spanning_tree_pairs(terminals, trees);
+         selected.resize(trees.size());
+         std::iota(selected.begin(), selected.end(), 0);
+         lower_bound = 0;
+      }
+   }
+
+   /*Draw the selected trees into the hanan grid*/
+   steiner_instance instance;
+   create_hanan_instance(terminals, instance, settings._trace);
+   std::vector<std::pair<size_t, size_t> > grid_edges;
+   {
+      ScopedPhase phase(settings._trace, "draw full steiner trees");
+      std::vector<std::vector<COOR> > coords(2);
+      for (size_t i = 0; i < instance._sizes[0]; ++i)
+      {
+         coords[0].push_back(instance._vertices[i]._coords[0]);
+      }
+      for (size_t i = 0; i < instance._sizes[1]; ++i)
+      {
+         coords[1].push_back(instance._vertices[i * instance._sizes[0]]._coords[1]);
+      }
+      std::vector<size_t> step;
+      sizes_to_steps(instance._sizes, step);
+      auto add_segment = [&](uint8_t axis, COOR from, COOR to, COOR other)
+      {
+         size_t other_index = std::distance(coords[1 - axis].begin(), std::lower_bound(coords[1 - axis].begin(), coords[1 - axis].end(), other));
+         size_t begin = std::distance(coords[axis].begin(), std::lower_bound(coords[axis].begin(), coords[axis].end(), std::min(from, to)));
+         size_t end = std::distance(coords[axis].begin(), std::lower_bound(coords[axis].begin(), coords[axis].end(), std::max(from, to)));
+         for (size_t i = begin; i < end; ++i)
+         {
+            size_t v = i * step[axis] + other_index * step[1 - axis];
+            grid_edges.emplace_back(v, v + step[axis]);
+         }
+      };
+      for (size_t i : selected)
+      {
+         full_steiner_tree const & fst = trees[i];
+         uint8_t axis = fst._axis;
+         std::vector<COOR> const & first = terminals[fst._first];
+         std::vector<COOR> end(first);
+         BITSET legs = fst._terminal_key & ~(BITSET(1) << fst._last[0]) & ~(BITSET(1) << fst._last[1]);
+         for (BITSET key = legs; key != 0; key &= key - 1)
+         {
+            std::vector<COOR> const & t = terminals[__builtin_ctzll(key)];
+            add_segment(1 - axis, first[1 - axis], t[1 - axis], t[axis]);
+            if (std::abs(t[axis] - first[axis]) > std::abs(end[axis] - first[axis]))
+            {
+               end[axis] = t[axis];
+            }
+         }
+         add_segment(axis, first[axis], end[axis], first[1 - axis]);
+         std::vector<COOR> center;
+         median(end, terminals[fst._last[0]], terminals[fst._last[1]], center);
+         std::vector<COOR> const * star[] = {&end, &terminals[fst._last[0]], &terminals[fst._last[1]]};
+         for (std::vector<COOR> const * t : star)
+         {
+            add_segment(0, center[0], (*t)[0], center[1]);
+            add_segment(1, center[1], (*t)[1], (*t)[0]);
+         }
+      }
+      std::sort(grid_edges.begin(), grid_edges.end());
+      grid_edges.erase(std::unique(grid_edges.begin(), grid_edges.end()), grid_edges.end());
+   }
+   /*Trees of a concatenation that isn't optimal may overlap and close cycles, the length is that of the drawn tree*/
+   std::vector<size_t> parent(instance._vertices.size());
+   std::iota(parent.begin(), parent.end(), 0);
+   DISTANCE_T length = 0;
+   size_t num_kept = 0;
+   for (std::pair<size_t, size_t> const & e : grid_edges)
+   {
+      size_t first_root = find_root(parent, e.first);
+      size_t second_root = find_root(parent, e.second);
+      if (first_root != second_root)
+      {
+         parent[first_root] = second_root;
+         length += manhattan_distance(instance._vertices[e.first]._coords, instance._vertices[e.second]._coords);
+         grid_edges[num_kept++] = e;
+      }
+   }
+   grid_edges.resize(num_kept);
+   compress_steinertree(instance, grid_edges, settings, steinerpoints, edges);
+   if (settings._bounds != nullptr)
+   {
+      settings._bounds->_lower_bound = std::min(std::max(lower_bound, terminal_extent(terminals)), length);
+      settings._bounds->_upper_bound = length;
+      settings._bounds->_labels_extracted = std::min(limits._num_steps, settings._label_limit == 0 ? limits._num_steps : settings._label_limit);
+   }
+   return length;
+}
@@ -0,0 +1,80 @@
+/*******************************************************************************
+ * Copyright (c) 2019 Paul Stahr
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ ******************************************************************************/
+
+#ifndef FULL_STEINER_TREE_H
+#define FULL_STEINER_TREE_H
+
+#include <vector>
+#include <chrono>
+#include "util.h"
+#include "dijkstra_steiner.h"
+
+/*A rectilinear full steiner tree in Hwang's form: a backbone along _axis starting in terminal _first with straight legs to all terminals but the last two,
+which join the end of the backbone in a steiner tree of three points*/
+struct full_steiner_tree{
+   BITSET _terminal_key;
+   DISTANCE_T _length;
+   uint8_t _axis;
+   uint8_t _first;
+   uint8_t _last[2];
+
+   full_steiner_tree() : _terminal_key(0), _length(0), _axis(0), _first(0), _last{0, 0}{}
+};
+
+/*Deadline and step limit shared by the generation and the concatenation, a step is a partial tree of the generation or a round of cuts*/
+struct full_steiner_tree_limits{
+   std::chrono::steady_clock::time_point _deadline;
+   size_t _step_limit;                     /*0 for no limit*/
+   size_t _num_steps;
+   bool _reached;
+
+   full_steiner_tree_limits() : _deadline(std::chrono::steady_clock::time_point::max()), _step_limit(0), _num_steps(0), _reached(false){}
+
+   /*Counts a step and reads the clock every clock_interval steps, returns true once a limit is reached*/
+   bool step(size_t clock_interval)
+   {
+      ++_num_steps;
+      _reached |= (_step_limit != 0 && _num_steps > _step_limit) || (_num_steps % clock_interval == 0 && std::chrono::steady_clock::now() >= _deadline);
+      return _reached;
+   }
+};
+
+/*Returns false if a limit stopped the generation, the trees are incomplete then*/
+bool generate_full_steiner_trees(std::vector<std::vector <COOR> > const & terminals, full_steiner_tree_limits & limits, std::vector<full_steiner_tree> & trees);
+
+/*Returns the best concatenation found before a limit, or the maximal length and no trees if there is none.
+lower_bound receives the length of an optimal concatenation, or the relaxation of the root if a limit stopped the search*/
+DISTANCE_T concatenate_full_steiner_trees(
+   std::vector<full_steiner_tree> const & trees,
+   size_t num_terminals,
+   full_steiner_tree_limits & limits,
+   std::vector<size_t> & selected,
+   DISTANCE_T & lower_bound);
+
+/*Optimal unless the time or label limit stops the generation or the concatenation, whose steps count as labels. Fills the bounds of the settings*/
+DISTANCE_T calculate_steinertree_full_steiner_trees(
+   std::vector<std::vector <COOR> > const & terminals,
+   dijkstra_steiner_settings const & settings,
+   std::vector<std::vector <COOR> > & steinerpoints,
+   std::vector<std::pair<size_t, size_t> > & edges);
+
+#endif
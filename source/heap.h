@@ -90,7 +90,7 @@ void make_heap (
    size_t size = std::distance(first, last);
    if (size >= 2)
    {
-      for (size_t i = size / 2 - 1; i --> 0;)
+      for (size_t i = size / 2; i --> 0;)
       {
          auto obj = *(first + i);
          size_t elem = i;
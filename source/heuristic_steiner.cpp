@@ -0,0 +1,360 @@
+/*******************************************************************************
+ * Copyright (c) 2019 Paul Stahr
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ ******************************************************************************/
+
+#include <vector>
+#include <limits>
+#include <stdexcept>
+#include <algorithm>
+#include <numeric>
+#include <cstdlib>
+#include <chrono>
+#include "heuristic_steiner.h"
+#include "phase_trace.h"
+
+/*Candidate connections of every point to the nearest points of other windows*/
+static const size_t stitch_neighbours = 4;
+
+struct stitch_connection{
+   DISTANCE_T _length;
+   size_t _first;
+   size_t _second;
+
+   stitch_connection(DISTANCE_T length_, size_t first_, size_t second_) : _length(length_), _first(first_), _second(second_){}
+
+   bool operator<(stitch_connection const & other) const{return _length < other._length;}
+};
+
+/*Implicit kd tree, the point of a node is in the middle of its range and _axis holds its splitting axis*/
+struct stitch_kd_tree{
+   std::vector<std::vector<COOR> > const & _coords;
+   std::vector<size_t> _points;
+   std::vector<uint8_t> _axis;
+
+   stitch_kd_tree(std::vector<std::vector<COOR> > const & coords) : _coords(coords), _points(coords.size()), _axis(coords.size(), 0)
+   {
+      std::iota(_points.begin(), _points.end(), 0);
+      build(0, _points.size(), 0);
+   }
+
+   void build(size_t begin, size_t end, size_t depth)
+   {
+      if (end - begin <= 1)
+      {
+         return;
+      }
+      size_t middle = (begin + end) / 2;
+      uint8_t axis = depth % _coords[0].size();
+      std::nth_element(_points.begin() + begin, _points.begin() + middle, _points.begin() + end, [this, axis](size_t lhs, size_t rhs){return _coords[lhs][axis] < _coords[rhs][axis];});
+      _axis[middle] = axis;
+      build(begin, middle, depth + 1);
+      build(middle + 1, end, depth + 1);
+   }
+
+   /*Keeps the nearest points accepted by the filter in nearest, sorted by distance*/
+   template <typename Filter>
+   void nearest(size_t begin, size_t end, std::vector<COOR> const & query, Filter filter, size_t k, std::vector<std::pair<DISTANCE_T, size_t> > & nearest_points) const
+   {
+      if (begin >= end)
+      {
+         return;
+      }
+      size_t middle = (begin + end) / 2;
+      size_t p = _points[middle];
+      if (filter(p))
+      {
+         DISTANCE_T distance = rectilinear_distance(query, _coords[p]);
+         if (nearest_points.size() < k || distance < nearest_points.back().first)
+         {
+            if (nearest_points.size() == k)
+            {
+               nearest_points.pop_back();
+            }
+            nearest_points.insert(std::upper_bound(nearest_points.begin(), nearest_points.end(), std::make_pair(distance, p)), std::make_pair(distance, p));
+         }
+      }
+      uint8_t axis = _axis[middle];
+      COOR difference = query[axis] - _coords[p][axis];
+      if (difference < 0)
+      {
+         nearest(begin, middle, query, filter, k, nearest_points);
+      }
+      else
+      {
+         nearest(middle + 1, end, query, filter, k, nearest_points);
+      }
+      if (nearest_points.size() < k || DISTANCE_T(std::abs(difference)) < nearest_points.back().first)
+      {
+         if (difference < 0)
+         {
+            nearest(middle + 1, end, query, filter, k, nearest_points);
+         }
+         else
+         {
+            nearest(begin, middle, query, filter, k, nearest_points);
+         }
+      }
+   }
+
+   static DISTANCE_T rectilinear_distance(std::vector<COOR> const & lhs, std::vector<COOR> const & rhs)
+   {
+      DISTANCE_T distance = 0;
+      for (size_t i = 0; i < lhs.size(); ++i)
+      {
+         distance += std::abs(lhs[i] - rhs[i]);
+      }
+      return distance;
+   }
+};
+
+static size_t find_root(std::vector<size_t> & parent, size_t i)
+{
+   while (parent[i] != i)
+   {
+      parent[i] = parent[parent[i]];
+      i = parent[i];
+   }
+   return i;
+}
+
+/*Orders the terminals so that every window is a contiguous range, all windows but the last of a split are full*/
+static void split_windows(
+   std::vector<std::vector <COOR> > const & terminals,
+   std::vector<size_t> & order,
+   size_t begin,
+   size_t end,
+   size_t window_size,
+   std::vector<size_t> & window_begins)
+{
+   if (end - begin <= window_size)
+   {
+      window_begins.push_back(begin);
+      return;
+   }
+   size_t axis = 0;
+   DISTANCE_T widest = 0;
+   for (size_t a = 0; a < terminals[order[begin]].size(); ++a)
+   {
+      auto minmax = std::minmax_element(order.begin() + begin, order.begin() + end, [&terminals, a](size_t lhs, size_t rhs){return terminals[lhs][a] < terminals[rhs][a];});
+      DISTANCE_T extent = terminals[*minmax.second][a] - terminals[*minmax.first][a];
+      if (extent > widest)
+      {
+         widest = extent;
+         axis = a;
+      }
+   }
+   size_t num_windows = (end - begin + window_size - 1) / window_size;
+   size_t middle = begin + num_windows / 2 * window_size;
+   std::nth_element(order.begin() + begin, order.begin() + middle, order.begin() + end, [&terminals, axis](size_t lhs, size_t rhs){return terminals[lhs][axis] < terminals[rhs][axis];});
+   split_windows(terminals, order, begin, middle, window_size, window_begins);
+   split_windows(terminals, order, middle, end, window_size, window_begins);
+}
+
+DISTANCE_T calculate_steinertree_heuristic(
+   DISTANCE_T (*lower_bound)(BITSET terminal_key, size_t vertex, steiner_instance const &),
+   std::vector<std::vector <COOR> > const & terminals,
+   dijkstra_steiner_settings const & settings,
+   std::vector<std::vector <COOR> > & steinerpoints,
+   std::vector<std::pair<size_t, size_t> > & edges)
+{
+   ScopedPhase phase(settings._trace, "split windows");
+   std::chrono::steady_clock::time_point start_time = std::chrono::steady_clock::now();
+   size_t num_terminals = terminals.size();
+   DISTANCE_T length = 0;
+
+   /*The exact solver needs distinct terminals, duplicates are attached to their first occurrence*/
+   std::vector<size_t> order(num_terminals);
+   std::iota(order.begin(), order.end(), 0);
+   std::sort(order.begin(), order.end(), [&terminals](size_t lhs, size_t rhs){return terminals[lhs] < terminals[rhs] || (terminals[lhs] == terminals[rhs] && lhs < rhs);});
+   std::vector<size_t> distinct;
+   distinct.reserve(num_terminals);
+   for (size_t i : order)
+   {
+      if (!distinct.empty() && terminals[distinct.back()] == terminals[i])
+      {
+         edges.emplace_back(distinct.back(), i);
+      }
+      else
+      {
+         distinct.push_back(i);
+      }
+   }
+   std::vector<size_t> window_begins;
+   split_windows(terminals, distinct, 0, distinct.size(), std::max(settings._heuristic_window_size, size_t(2)), window_begins);
+   window_begins.push_back(distinct.size());
+   size_t num_windows = window_begins.size() - 1;
+
+   phase.next("solve windows");
+   dijkstra_steiner_settings window_settings(settings);
+   window_settings._heuristic_threshold = 0;
+   window_settings._heuristic_threshold_high_dim = 0;
+   dijkstra_steiner_bounds window_bounds;
+   window_settings._bounds = &window_bounds;
+   window_settings._memory_usage = nullptr;
+   window_settings._statistics = nullptr;
+   window_settings._progress_callback = nullptr;
+   window_settings._trace = nullptr;
+   /*Terminals and steinerpoints of the window trees, numbered like in the output, grouped by window*/
+   std::vector<size_t> points;
+   std::vector<size_t> point_window;
+   std::vector<std::vector<COOR> > point_coords;
+   size_t num_extracted = 0;
+   for (size_t w = 0; w < num_windows; ++w)
+   {
+      std::vector<std::vector <COOR> > window_terminals;
+      for (size_t i = window_begins[w]; i < window_begins[w + 1]; ++i)
+      {
+         window_terminals.push_back(terminals[distinct[i]]);
+         points.push_back(distinct[i]);
+         point_window.push_back(w);
+         point_coords.push_back(terminals[distinct[i]]);
+      }
+      if (window_terminals.size() < 2)
+      {
+         continue;
+      }
+      /*What is left of the limits is split evenly among the remaining windows, a window out of time still returns a tree*/
+      size_t num_remaining = num_windows - w;
+      if (settings._time_limit_seconds != 0)
+      {
+         double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+         window_settings._time_limit_seconds = std::max((settings._time_limit_seconds - elapsed) / num_remaining, 1e-9);
+      }
+      if (settings._label_limit != 0)
+      {
+         window_settings._label_limit = std::max((settings._label_limit - std::min(num_extracted, settings._label_limit)) / num_remaining, size_t(1));
+      }
+      std::vector<std::vector <COOR> > window_steinerpoints;
+      std::vector<std::pair<size_t, size_t> > window_edges;
+      length += calculate_steinertree(lower_bound, window_terminals, window_settings, window_steinerpoints, window_edges);
+      num_extracted += window_bounds._labels_extracted;
+      size_t steinerpoint_offset = num_terminals + steinerpoints.size() - window_terminals.size();
+      for (std::vector<COOR> const & sp : window_steinerpoints)
+      {
+         points.push_back(num_terminals + steinerpoints.size());
+         point_window.push_back(w);
+         point_coords.push_back(sp);
+         steinerpoints.push_back(sp);
+      }
+      for (std::pair<size_t, size_t> const & e : window_edges)
+      {
+         edges.emplace_back(
+            e.first < window_terminals.size() ? distinct[window_begins[w] + e.first] : steinerpoint_offset + e.first,
+            e.second < window_terminals.size() ? distinct[window_begins[w] + e.second] : steinerpoint_offset + e.second);
+      }
+   }
+
+   /*Spanning tree over the windows from connections to the nearest points of other windows*/
+   phase.next("stitch windows");
+   stitch_kd_tree tree(point_coords);
+   std::vector<stitch_connection> candidates;
+   candidates.reserve(points.size() * stitch_neighbours);
+   std::vector<std::pair<DISTANCE_T, size_t> > nearest_points;
+   for (size_t i = 0; i < points.size(); ++i)
+   {
+      nearest_points.clear();
+      size_t window = point_window[i];
+      tree.nearest(0, points.size(), point_coords[i], [&point_window, window](size_t p){return point_window[p] != window;}, stitch_neighbours, nearest_points);
+      for (std::pair<DISTANCE_T, size_t> const & n : nearest_points)
+      {
+         candidates.emplace_back(n.first, i, n.second);
+      }
+   }
+   std::sort(candidates.begin(), candidates.end());
+   std::vector<size_t> parent(num_windows);
+   std::iota(parent.begin(), parent.end(), 0);
+   std::vector<stitch_connection> connections;
+   for (stitch_connection const & c : candidates)
+   {
+      size_t first_root = find_root(parent, point_window[c._first]);
+      size_t second_root = find_root(parent, point_window[c._second]);
+      if (first_root != second_root)
+      {
+         parent[first_root] = second_root;
+         connections.push_back(c);
+      }
+   }
+   /*Groups of windows without candidates between them are chained in window order, consecutive windows are neighbours in space*/
+   std::vector<size_t> window_point_begins(num_windows + 1, points.size());
+   for (size_t i = points.size(); i --> 0;)
+   {
+      window_point_begins[point_window[i]] = i;
+   }
+   for (size_t w = 0; w + 1 < num_windows; ++w)
+   {
+      size_t first_root = find_root(parent, w);
+      size_t second_root = find_root(parent, w + 1);
+      if (first_root == second_root)
+      {
+         continue;
+      }
+      stitch_connection best(std::numeric_limits<DISTANCE_T>::max(), 0, 0);
+      for (size_t i = window_point_begins[w]; i < window_point_begins[w + 1]; ++i)
+      {
+         for (size_t j = window_point_begins[w + 1]; j < window_point_begins[w + 2]; ++j)
+         {
+            DISTANCE_T distance = stitch_kd_tree::rectilinear_distance(point_coords[i], point_coords[j]);
+            if (distance < best._length)
+            {
+               best = stitch_connection(distance, i, j);
+            }
+         }
+      }
+      parent[first_root] = second_root;
+      connections.push_back(best);
+   }
+
+   for (stitch_connection const & c : connections)
+   {
+      length += c._length;
+      size_t last = points[c._first];
+      std::vector<COOR> corner = point_coords[c._first];
+      std::vector<COOR> const & target = point_coords[c._second];
+      if (settings._edge_as_steinerpoint)
+      {
+         /*Every edge is axis parallel, so the connection bends in steinerpoints*/
+         size_t num_differing = 0;
+         for (size_t a = 0; a < corner.size(); ++a)
+         {
+            num_differing += corner[a] != target[a];
+         }
+         for (size_t a = 0; a < corner.size() && num_differing > 1; ++a)
+         {
+            if (corner[a] != target[a])
+            {
+               corner[a] = target[a];
+               edges.emplace_back(last, num_terminals + steinerpoints.size());
+               last = num_terminals + steinerpoints.size();
+               steinerpoints.push_back(corner);
+               --num_differing;
+            }
+         }
+      }
+      edges.emplace_back(last, points[c._second]);
+   }
+   if (settings._bounds != nullptr)
+   {
+      settings._bounds->_lower_bound = terminal_extent(terminals);
+      settings._bounds->_upper_bound = length;
+      settings._bounds->_labels_extracted = num_extracted;
+   }
+   return length;
+}
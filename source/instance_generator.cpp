@@ -0,0 +1,132 @@
+/*******************************************************************************
+ * Copyright (c) 2019 Paul Stahr
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ ******************************************************************************/
+
+#include <random>
+#include <cmath>
+#include <set>
+#include <stdexcept>
+#include <algorithm>
+#include "instance_generator.h"
+
+const char* terminal_distribution_name(terminal_distribution distribution)
+{
+   switch (distribution)
+   {
+      case UNIFORM_TERMINALS:       return "uniform";
+      case CLUSTERED_TERMINALS:     return "clustered";
+      case COLLINEAR_TERMINALS:     return "collinear";
+      case GRID_ALIGNED_TERMINALS:  return "grid";
+   }
+   return "unknown";
+}
+
+void generate_terminals(
+   terminal_distribution distribution,
+   size_t dim,
+   size_t num_terminals,
+   COOR range,
+   uint32_t seed,
+   std::vector<std::vector<COOR> > & terminals)
+{
+   std::mt19937 gen(seed);
+   std::uniform_int_distribution<COOR> coordinate(0, range - 1);
+   std::vector<std::vector<COOR> > centers;
+   std::vector<COOR> line_begin(dim), line_end(dim);
+   COOR grid_step = std::max(range / 8, COOR(1));
+   switch (distribution)
+   {
+      case CLUSTERED_TERMINALS:
+         centers.resize(std::max(num_terminals / 6, size_t(2)));
+         for (std::vector<COOR> & center : centers)
+         {
+            for (size_t i = 0; i < dim; ++i)
+            {
+               center.push_back(coordinate(gen));
+            }
+         }
+         break;
+      case COLLINEAR_TERMINALS:
+         /*Points on a segment crossing the whole range along the first axis*/
+         for (size_t i = 1; i < dim; ++i)
+         {
+            line_begin[i] = coordinate(gen);
+            line_end[i] = coordinate(gen);
+         }
+         line_end[0] = range - 1;
+         break;
+      default:
+         break;
+   }
+   if (distribution == GRID_ALIGNED_TERMINALS && num_terminals > std::pow(double((range + grid_step - 1) / grid_step), double(dim)))
+   {
+      throw std::runtime_error("Too many terminals for grid aligned instance");
+   }
+   if (num_terminals > std::pow(double(range), double(distribution == COLLINEAR_TERMINALS ? 1 : dim)))
+   {
+      throw std::runtime_error("Too many terminals for range");
+   }
+
+   std::set<std::vector<COOR> > used;
+   terminals.clear();
+   std::vector<COOR> point(dim);
+   while (terminals.size() < num_terminals)
+   {
+      switch (distribution)
+      {
+         case UNIFORM_TERMINALS:
+            for (COOR & c : point)
+            {
+               c = coordinate(gen);
+            }
+            break;
+         case CLUSTERED_TERMINALS:
+         {
+            std::vector<COOR> const & center = centers[gen() % centers.size()];
+            std::normal_distribution<double> spread(0, range / 20. + 1);
+            for (size_t i = 0; i < dim; ++i)
+            {
+               point[i] = std::min(std::max(COOR(center[i] + spread(gen)), COOR(0)), range - 1);
+            }
+            break;
+         }
+         case COLLINEAR_TERMINALS:
+         {
+            double t = coordinate(gen) / std::max(double(range - 1), 1.);
+            for (size_t i = 0; i < dim; ++i)
+            {
+               point[i] = line_begin[i] + COOR(std::round((line_end[i] - line_begin[i]) * t));
+            }
+            break;
+         }
+         case GRID_ALIGNED_TERMINALS:
+            for (COOR & c : point)
+            {
+               c = coordinate(gen) / grid_step * grid_step;
+            }
+            break;
+      }
+      if (used.insert(point).second)
+      {
+         terminals.push_back(point);
+      }
+   }
+}
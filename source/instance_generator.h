@@ -0,0 +1,49 @@
+/*******************************************************************************
+ * Copyright (c) 2019 Paul Stahr
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ ******************************************************************************/
+
+#ifndef INSTANCE_GENERATOR_H
+#define INSTANCE_GENERATOR_H
+
+#include <cstdint>
+#include <vector>
+#include "util.h"
+
+enum terminal_distribution
+{
+   UNIFORM_TERMINALS,
+   CLUSTERED_TERMINALS,
+   COLLINEAR_TERMINALS,
+   GRID_ALIGNED_TERMINALS
+};
+
+const char* terminal_distribution_name(terminal_distribution distribution);
+
+/*Distinct terminals with coordinates in [0, range), the same seed always gives the same terminals*/
+void generate_terminals(
+   terminal_distribution distribution,
+   size_t dim,
+   size_t num_terminals,
+   COOR range,
+   uint32_t seed,
+   std::vector<std::vector<COOR> > & terminals);
+
+#endif
@@ -24,7 +24,8 @@
 #include <algorithm>
 #include <sstream>
 #include <fstream>
-#include <numeric>
+#include <limits>
+#include <stdexcept>
 
 #include "instance_io.h"
 #include "util.h"
@@ -98,32 +99,8 @@ void read_instance(std::ifstream & stream, steiner_instance & instance, size_t d
          }
       }
       coords[i].resize(write_index);
-      instance._sizes.push_back(coords[i].size());
-   }
-   instance._vertices.clear();
-   instance._vertices.reserve(std::accumulate(instance._sizes.begin(), instance._sizes.end(), size_t(1), std::multiplies<size_t>()));
-
-   std::vector<size_t> indices(dim, 0);
-   while (indices.back() < instance._sizes.back())
-   {
-      instance._vertices.push_back(vertex());
-      vertex & current_v = instance._vertices.back();
-      current_v._coords.reserve(dim);
-      for (size_t i = 0; i < dim; ++i)
-      {
-         current_v._coords.push_back(coords[i][indices[i]]);
-      }
-      current_v._is_excluded = false;
-      current_v._terminal_number = std::numeric_limits<unsigned char>::max();
-
-      /*Enumerate all combination of indices*/
-      size_t i;
-      for (i = 0; i < dim - 1 && indices[i] >= instance._sizes[i] - 1; ++i)
-      {
-         indices[i] = 0;
-      }
-      ++indices[i];
    }
+   create_grid_vertices(coords, instance);
 
    instance._terminals.reserve(terminal_coords.size());
    instance._terminal_coords.reserve(terminal_coords.size());
@@ -20,39 +20,140 @@
  * SOFTWARE.
  ******************************************************************************/
 
+#include <chrono>
 #include <iostream>
 #include <fstream>
 #include <exception>
+#include <string>
+#include <vector>
 
 #include "dijkstra_steiner.h"
 #include "instance_io.h"
+#include "estimator.h"
 #include "util.h"
+#include "phase_trace.h"
 
 int main(int argc, const char *argv[])
 {
-   if (argc != 2)
+   std::vector<std::string> files;
+   std::string trace_file;
+   double time_limit = 0;
+   bool estimate = false;
+   bool timing = false;
+   for (int i = 1; i < argc; ++i)
    {
-      std::cout << "steinertree <file>" << std::endl;
-      return 0;
+      if (std::string(argv[i]) == "--trace" && i + 1 < argc)
+      {
+         trace_file = argv[++i];
+      }
+      else if (std::string(argv[i]) == "--time-limit" && i + 1 < argc)
+      {
+         time_limit = std::stod(argv[++i]);
+      }
+      else if (std::string(argv[i]) == "--estimate")
+      {
+         estimate = true;
+      }
+      else if (std::string(argv[i]) == "--timing")
+      {
+         timing = true;
+      }
+      else
+      {
+         files.push_back(argv[i]);
+      }
    }
-
-   steiner_instance instance;
-   std::ifstream file;
-   file.open (argv[1]);
-   if (!file.good())
+   if (files.empty())
    {
-      throw std::runtime_error("file does't exist");
+      std::cout << "steinertree [--trace <trace.json>] [--time-limit <seconds>] [--estimate] [--timing] <file>..." << std::endl;
+      return 0;
    }
-   read_instance(file, instance, 3);
-   file.close();
-   mark_excluded_vertices(instance);
-   print_instance(instance);
 
    dijkstra_steiner_settings settings;
    settings._small_memory_mode = false;  //deletes object when possible, less memory use but higher runtime
    settings._maximum_heap_width = 20;    //lower values can result in less memory consumption but increase runtime
+   settings._out_of_core_mode = false;   //keeps permanent labels in spill files in settings._spill_directory, for instances larger than memory
+   settings._superset_dominance = false; //drops labels dominated by a label with more terminals at the same vertex, pays off on dense instances
+   settings._memory_budget_bytes = 0;    //0 for no limit, otherwise switches to cheaper representations when approaching it
+   settings._epsilon = 0;                //weights the lower bound by 1 + epsilon, faster but up to 1 + epsilon times optimal
+   settings._time_limit_seconds = time_limit;   //0 for no limit, otherwise returns the best tree found so far with a lower bound
+   settings._label_limit = 0;            //0 for no limit, otherwise stops after extracting this many labels
+   dijkstra_steiner_bounds bounds;
+   settings._bounds = &bounds;
+
+   PhaseTrace trace;
+   if (!trace_file.empty())
+   {
+      settings._trace = &trace;        //phase durations, written as chrome trace events (chrome://tracing, ui.perfetto.dev)
+   }
+
+#ifdef DIJKSTRA_STEINER_STATISTICS
+   dijkstra_steiner_statistics statistics;
+   settings._statistics = &statistics;
+#endif
 
-   std::vector<std::pair<size_t, size_t> > edges;
-   std::cout << calculate_steinertree(*boundingbox_lower_bound, instance, settings, edges) << std::endl;
+   for (std::string const & filename : files)
+   {
+      steiner_instance instance;
+      std::chrono::steady_clock::time_point startup_begin = std::chrono::steady_clock::now();   //parsing, grid, exclusion and neighbours, reported apart from the search
+      {
+         ScopedPhase phase(settings._trace, "read_instance");
+         std::ifstream file;
+         file.open (filename);
+         if (!file.good())
+         {
+            throw std::runtime_error("file does't exist");
+         }
+         read_instance(file, instance, 3);
+         file.close();
+         phase.next("mark_excluded_vertices");
+         mark_excluded_vertices(instance);
+      }
+      std::chrono::steady_clock::time_point startup_end = std::chrono::steady_clock::now();
+      if (files.size() == 1)
+      {
+         print_instance(instance);
+      }
+
+      if (estimate)
+      {
+         estimator_features features;
+         compute_estimator_features(*boundingbox_lower_bound, instance, settings, 500, features);
+         estimator_prediction prediction;
+         estimate_resources(features, estimator_model(), prediction);
+         std::cerr << "estimate labels " << prediction._labels << " seconds " << prediction._seconds << " peak bytes " << prediction._peak_bytes << std::endl;
+      }
+
+      std::chrono::steady_clock::time_point search_begin = std::chrono::steady_clock::now();
+      std::vector<std::pair<size_t, size_t> > edges;
+      DISTANCE_T length = calculate_steinertree(*boundingbox_lower_bound, instance, settings, edges);
+      std::chrono::steady_clock::time_point search_end = std::chrono::steady_clock::now();
+      if (files.size() != 1)
+      {
+         std::cout << filename << ' ';
+      }
+      std::cout << length;
+      if (bounds._lower_bound != length)
+      {
+         std::cout << " (lower bound " << bounds._lower_bound << ')';
+      }
+      std::cout << std::endl;
+      if (timing)
+      {
+         std::cerr << "startup " << std::chrono::duration<double>(startup_end - startup_begin).count() << " s search " << std::chrono::duration<double>(search_end - search_begin).count() << " s" << std::endl;
+      }
+#ifdef DIJKSTRA_STEINER_STATISTICS
+      std::cerr << "created " << statistics._labels_created << " decreased " << statistics._labels_decreased << " extracted " << statistics._labels_extracted << " discarded " << statistics._labels_discarded << " dominated " << statistics._labels_dominated << std::endl;
+      std::cerr << "merges scanned " << statistics._merges_scanned << " accepted " << statistics._merges_accepted << std::endl;
+      std::cerr << "peak heap " << statistics._peak_heap_size << " trie layers " << statistics._trie_layers << " lower bound calls " << statistics._lower_bound_calls << std::endl;
+#endif
+   }
+
+   if (!trace_file.empty())
+   {
+      std::ofstream out(trace_file);
+      trace.write_chrome_trace(out);
+      trace.write_summary(std::cerr);
+   }
    return 0;
 }
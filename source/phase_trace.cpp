@@ -0,0 +1,68 @@
+/*******************************************************************************
+ * Copyright (c) 2019 Paul Stahr
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ ******************************************************************************/
+
+#include <functional>
+#include <map>
+#include <thread>
+#include "phase_trace.h"
+
+PhaseTrace::PhaseTrace() : _start(std::chrono::steady_clock::now()){}
+
+void PhaseTrace::add(std::string const & name, std::chrono::steady_clock::time_point begin, std::chrono::steady_clock::time_point end)
+{
+   phase_event event;
+   event._name = name;
+   event._begin = std::chrono::duration_cast<std::chrono::microseconds>(begin - _start).count();
+   event._duration = std::chrono::duration_cast<std::chrono::microseconds>(end - begin).count();
+   event._thread = std::hash<std::thread::id>()(std::this_thread::get_id()) % 1000000;
+   std::lock_guard<std::mutex> lock(_mutex);
+   _events.push_back(event);
+}
+
+void PhaseTrace::write_chrome_trace(std::ostream & out) const
+{
+   std::lock_guard<std::mutex> lock(_mutex);
+   out << "{\"traceEvents\":[";
+   for (size_t i = 0; i < _events.size(); ++i)
+   {
+      phase_event const & event = _events[i];
+      out << (i == 0 ? "\n" : ",\n");
+      out << "{\"name\":\"" << event._name << "\",\"ph\":\"X\",\"ts\":" << event._begin << ",\"dur\":" << event._duration << ",\"pid\":1,\"tid\":" << event._thread << '}';
+   }
+   out << "\n],\"displayTimeUnit\":\"ms\"}\n";
+}
+
+void PhaseTrace::write_summary(std::ostream & out) const
+{
+   std::lock_guard<std::mutex> lock(_mutex);
+   std::map<std::string, std::pair<uint64_t, size_t> > totals;
+   for (phase_event const & event : _events)
+   {
+      std::pair<uint64_t, size_t> & total = totals[event._name];
+      total.first += event._duration;
+      ++total.second;
+   }
+   for (auto const & total : totals)
+   {
+      out << total.first << ' ' << total.second.first / 1000. << " ms in " << total.second.second << " calls" << std::endl;
+   }
+}
@@ -0,0 +1,99 @@
+/*******************************************************************************
+ * Copyright (c) 2019 Paul Stahr
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ ******************************************************************************/
+
+#ifndef PHASE_TRACE_H
+#define PHASE_TRACE_H
+
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+struct phase_event{
+   std::string _name;
+   uint64_t _begin;       /*microseconds since the trace was created*/
+   uint64_t _duration;
+   size_t _thread;
+};
+
+/*Collects the durations of the pipeline phases, written as chrome trace events or summed per phase*/
+class PhaseTrace{
+public:
+   PhaseTrace();
+
+   void add(std::string const & name, std::chrono::steady_clock::time_point begin, std::chrono::steady_clock::time_point end);
+
+   void write_chrome_trace(std::ostream & out) const;
+
+   void write_summary(std::ostream & out) const;
+
+   std::vector<phase_event> const & events() const{return _events;}
+
+private:
+   std::chrono::steady_clock::time_point _start;
+   std::vector<phase_event> _events;
+   mutable std::mutex _mutex;
+};
+
+/*Adds the lifetime of the object as a phase to the trace, does nothing without a trace*/
+class ScopedPhase{
+public:
+   ScopedPhase(PhaseTrace *trace, const char *name) : _trace(trace), _name(name)
+   {
+      if (_trace != nullptr)
+      {
+         _begin = std::chrono::steady_clock::now();
+      }
+   }
+
+   ~ScopedPhase()
+   {
+      if (_trace != nullptr)
+      {
+         _trace->add(_name, _begin, std::chrono::steady_clock::now());
+      }
+   }
+
+   /*Ends the current phase and starts the next one*/
+   void next(const char *name)
+   {
+      if (_trace != nullptr)
+      {
+         std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+         _trace->add(_name, _begin, now);
+         _begin = now;
+      }
+      _name = name;
+   }
+
+   ScopedPhase(ScopedPhase const &) = delete;
+   ScopedPhase & operator=(ScopedPhase const &) = delete;
+
+private:
+   PhaseTrace *_trace;
+   const char *_name;
+   std::chrono::steady_clock::time_point _begin;
+};
+
+#endif
@@ -0,0 +1,308 @@
+/*******************************************************************************
+ * Copyright (c) 2019 Paul Stahr
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ ******************************************************************************/
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <memory>
+#include <exception>
+#include <stdexcept>
+#include <algorithm>
+#include <numeric>
+#include <cstdlib>
+#include <unistd.h>
+#include "portfolio.h"
+#include "autotune.h"
+#include "phase_trace.h"
+
+/*Extractions between two checks whether another configuration already won*/
+static const size_t portfolio_step_extractions = 16;
+
+/*Width of the narrow tries of the sparse configuration*/
+static const size_t portfolio_sparse_width = 10;
+
+/*Result of the race, written by the configurations under the mutex*/
+struct portfolio_race{
+   std::mutex _mutex;
+   std::condition_variable _started;       /*notified when a configuration has built its instance and search, or has ended*/
+   size_t _num_started;
+   std::unique_ptr<std::atomic<size_t>[]> _live_bytes;   /*memory of each launched configuration, updated while it runs*/
+   std::atomic<bool> _cancelled;
+   bool _has_result;
+   bool _optimal;
+   DISTANCE_T _length;
+   DISTANCE_T _lower_bound;                /*largest lower bound of all configurations, each of them bounds the same optimum*/
+   size_t _labels_extracted;
+   std::vector<std::vector <COOR> > _steinerpoints;
+   std::vector<std::pair<size_t, size_t> > _edges;
+   std::exception_ptr _error;
+
+   portfolio_race(size_t num_configurations) : _num_started(0), _live_bytes(new std::atomic<size_t>[num_configurations]), _cancelled(false), _has_result(false), _optimal(false), _length(0), _lower_bound(0), _labels_extracted(0){}
+};
+
+void portfolio_configurations(
+   DISTANCE_T (*lower_bound)(BITSET terminal_key, size_t vertex, steiner_instance const &),
+   std::vector<std::vector <COOR> > const & terminals,
+   size_t num_configurations,
+   std::vector<portfolio_configuration> & configurations)
+{
+   size_t num_terminals = terminals.size();
+   instance_features features;
+   compute_instance_features(terminals, features);
+   autotune_choice choice;
+   autotune(features, choice);
+   portfolio_configuration tuned;
+   tuned._root = choice._root;
+   tuned._maximum_heap_width = choice._maximum_heap_width;
+   tuned._small_memory_mode = false;
+   tuned._lower_bound = lower_bound;
+
+   /*Roots by ascending sum of distances to the other terminals, the medoid first and the most eccentric terminal last*/
+   std::vector<DISTANCE_T> distance_sum(num_terminals, 0);
+   for (size_t i = 0; i < num_terminals; ++i)
+   {
+      for (size_t j = 0; j < num_terminals; ++j)
+      {
+         for (size_t a = 0; a < terminals[i].size(); ++a)
+         {
+            distance_sum[i] += std::abs(terminals[i][a] - terminals[j][a]);
+         }
+      }
+   }
+   std::vector<size_t> roots(num_terminals);
+   std::iota(roots.begin(), roots.end(), 0);
+   std::stable_sort(roots.begin(), roots.end(), [&distance_sum](size_t lhs, size_t rhs){return distance_sum[lhs] < distance_sum[rhs];});
+
+   configurations.clear();
+   configurations.push_back(tuned);
+   portfolio_configuration last_root(tuned);
+   last_root._root = num_terminals - 1;
+   portfolio_configuration eccentric_root(tuned);
+   eccentric_root._root = roots.back();
+   portfolio_configuration other_bound(tuned);
+   other_bound._lower_bound = lower_bound == small_subset_lower_bound ? boundingbox_lower_bound : small_subset_lower_bound;
+   portfolio_configuration sparse(tuned);
+   sparse._maximum_heap_width = std::min(tuned._maximum_heap_width, portfolio_sparse_width);
+   sparse._small_memory_mode = true;
+   for (portfolio_configuration const & c : {last_root, other_bound, eccentric_root, sparse})
+   {
+      configurations.push_back(c);
+   }
+   for (size_t root : roots)
+   {
+      portfolio_configuration other_root(tuned);
+      other_root._root = root;
+      configurations.push_back(other_root);
+   }
+   /*A configuration equal to an earlier one, e.g. the last terminal as root when it is the medoid, is raced once*/
+   std::vector<portfolio_configuration> distinct;
+   for (portfolio_configuration const & c : configurations)
+   {
+      if (distinct.size() < num_configurations && std::none_of(distinct.begin(), distinct.end(), [&c](portfolio_configuration const & d){
+         return d._root == c._root
+            && d._maximum_heap_width == c._maximum_heap_width
+            && d._small_memory_mode == c._small_memory_mode
+            && d._lower_bound == c._lower_bound;}))
+      {
+         distinct.push_back(c);
+      }
+   }
+   configurations.swap(distinct);
+}
+
+/*Memory of the hanan grid, the part of a search which is known before it starts. The tries of the vertices are allocated on first touch
+and are counted in the live memory of the search*/
+static size_t portfolio_grid_bytes(instance_features const & features)
+{
+   size_t vertex_bytes = sizeof(vertex) + features._dim * sizeof(COOR) + 2 * features._dim * sizeof(neighbour);
+   return features._num_vertices * vertex_bytes;
+}
+
+/*Tells the launcher that this configuration's memory is known, also if it ended before*/
+static void notify_started(portfolio_race & race, bool & started)
+{
+   if (!started)
+   {
+      started = true;
+      std::lock_guard<std::mutex> lock(race._mutex);
+      ++race._num_started;
+      race._started.notify_all();
+   }
+}
+
+static void run_configuration(
+   std::vector<std::vector <COOR> > const & terminals,
+   portfolio_configuration const & configuration,
+   size_t index,
+   dijkstra_steiner_settings const & settings,
+   size_t memory_budget_bytes,
+   portfolio_race & race)
+{
+   bool started = false;
+   try
+   {
+      size_t last = terminals.size() - 1;
+      std::vector<std::vector <COOR> > rooted_terminals(terminals);
+      std::swap(rooted_terminals[configuration._root], rooted_terminals[last]);
+      steiner_instance instance;
+      create_hanan_instance(rooted_terminals, instance, settings._trace);
+      dijkstra_steiner_settings configuration_settings(settings);
+      configuration_settings._maximum_heap_width = configuration._maximum_heap_width;
+      configuration_settings._small_memory_mode = configuration._small_memory_mode;
+      configuration_settings._memory_budget_bytes = memory_budget_bytes;
+      configuration_settings._bounds = nullptr;
+      configuration_settings._memory_usage = nullptr;
+      configuration_settings._statistics = nullptr;
+      configuration_settings._progress_callback = nullptr;
+
+      ScopedPhase phase(settings._trace, "portfolio search");
+      DijkstraSteinerSearch search(configuration._lower_bound, instance, configuration_settings);
+      race._live_bytes[index] = search.memory_usage().total();
+      notify_started(race, started);
+      while (!race._cancelled && !search.step(portfolio_step_extractions))
+      {
+         race._live_bytes[index] = search.memory_usage().total();
+      }
+      if (!search.is_done())
+      {
+         std::lock_guard<std::mutex> lock(race._mutex);
+         race._lower_bound = std::max(race._lower_bound, search.lower_bound());
+         race._labels_extracted += search.labels_extracted();
+         return;
+      }
+      std::vector<std::pair<size_t, size_t> > grid_edges;
+      DISTANCE_T length = search.result(grid_edges);
+      std::vector<std::vector <COOR> > steinerpoints;
+      std::vector<std::pair<size_t, size_t> > edges;
+      compress_steinertree(instance, grid_edges, settings, steinerpoints, edges);
+      for (std::pair<size_t, size_t> & e : edges)
+      {
+         for (size_t *index : {&e.first, &e.second})
+         {
+            if (*index == configuration._root)
+            {
+               *index = last;
+            }
+            else if (*index == last)
+            {
+               *index = configuration._root;
+            }
+         }
+      }
+
+      std::lock_guard<std::mutex> lock(race._mutex);
+      race._lower_bound = std::max(race._lower_bound, search.lower_bound());
+      race._labels_extracted += search.labels_extracted();
+      if (!race._optimal && (search.is_optimal() || !race._has_result || length < race._length))
+      {
+         race._has_result = true;
+         race._optimal = search.is_optimal();
+         race._length = length;
+         race._steinerpoints.swap(steinerpoints);
+         race._edges.swap(edges);
+      }
+      if (search.is_optimal())
+      {
+         race._cancelled = true;
+      }
+   }
+   catch (...)
+   {
+      std::lock_guard<std::mutex> lock(race._mutex);
+      if (!race._error)
+      {
+         race._error = std::current_exception();
+      }
+   }
+   notify_started(race, started);
+}
+
+DISTANCE_T calculate_steinertree_portfolio(
+   DISTANCE_T (*lower_bound)(BITSET terminal_key, size_t vertex, steiner_instance const &),
+   std::vector<std::vector <COOR> > const & terminals,
+   dijkstra_steiner_settings const & settings,
+   std::vector<std::vector <COOR> > & steinerpoints,
+   std::vector<std::pair<size_t, size_t> > & edges)
+{
+   instance_features features;
+   compute_instance_features(terminals, features);
+   std::vector<portfolio_configuration> configurations;
+   portfolio_configurations(lower_bound, terminals, settings._portfolio_threads, configurations);
+
+   size_t available_bytes = settings._memory_budget_bytes;
+   if (available_bytes == 0)
+   {
+      available_bytes = size_t(sysconf(_SC_AVPHYS_PAGES)) * size_t(sysconf(_SC_PAGESIZE));
+   }
+   /*The configurations share the budget, so that together they stay within it*/
+   size_t memory_budget_bytes = settings._memory_budget_bytes / configurations.size();
+   size_t grid_bytes = portfolio_grid_bytes(features);
+   portfolio_race race(configurations.size());
+   std::vector<std::thread> threads;
+   for (size_t i = 0; i < configurations.size(); ++i)
+   {
+      /*The first configuration always runs, the others only if they leave headroom for the running ones*/
+      if (!threads.empty())
+      {
+         std::unique_lock<std::mutex> lock(race._mutex);
+         race._started.wait(lock, [&race, &threads]{return race._num_started == threads.size();});
+         if (race._cancelled)
+         {
+            break;
+         }
+         size_t live_bytes = 0;
+         for (size_t j = 0; j < threads.size(); ++j)
+         {
+            live_bytes += grid_bytes + race._live_bytes[j];
+         }
+         if (live_bytes + grid_bytes > available_bytes)
+         {
+            break;
+         }
+      }
+      race._live_bytes[i] = 0;
+      threads.emplace_back(run_configuration, std::cref(terminals), std::cref(configurations[i]), i, std::cref(settings), memory_budget_bytes, std::ref(race));
+   }
+   for (std::thread & t : threads)
+   {
+      t.join();
+   }
+   if (!race._has_result)
+   {
+      if (race._error)
+      {
+         std::rethrow_exception(race._error);
+      }
+      throw std::runtime_error("No configuration of the portfolio finished");
+   }
+   steinerpoints.swap(race._steinerpoints);
+   edges.swap(race._edges);
+   if (settings._bounds != nullptr)
+   {
+      settings._bounds->_lower_bound = race._optimal ? race._length : std::min(race._lower_bound, race._length);
+      settings._bounds->_upper_bound = race._length;
+      settings._bounds->_labels_extracted = race._labels_extracted;
+   }
+   return race._length;
+}
@@ -0,0 +1,56 @@
+/*******************************************************************************
+ * Copyright (c) 2019 Paul Stahr
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ ******************************************************************************/
+
+#ifndef PORTFOLIO_H
+#define PORTFOLIO_H
+
+#include <vector>
+#include "util.h"
+#include "dijkstra_steiner.h"
+
+/*One configuration of the labelling algorithm raced by the portfolio*/
+struct portfolio_configuration{
+   size_t _root;                           /*terminal to be used as the root of the search*/
+   size_t _maximum_heap_width;
+   bool _small_memory_mode;
+   DISTANCE_T (*_lower_bound)(BITSET terminal_key, size_t vertex, steiner_instance const &);
+};
+
+/*The autotuned configuration with the given bound first, then other roots, the other of the bounding box and the small subset bound
+and narrow tries*/
+void portfolio_configurations(
+   DISTANCE_T (*lower_bound)(BITSET terminal_key, size_t vertex, steiner_instance const &),
+   std::vector<std::vector <COOR> > const & terminals,
+   size_t num_configurations,
+   std::vector<portfolio_configuration> & configurations);
+
+/*Races _portfolio_threads configurations on their own threads and returns the first optimal tree, the others are cancelled.
+Each configuration gets an equal share of the memory budget. The configurations are launched one after another, the next one only
+if the memory the running ones use by now and the grid of the next one fit into the free memory or the memory budget*/
+DISTANCE_T calculate_steinertree_portfolio(
+   DISTANCE_T (*lower_bound)(BITSET terminal_key, size_t vertex, steiner_instance const &),
+   std::vector<std::vector <COOR> > const & terminals,
+   dijkstra_steiner_settings const & settings,
+   std::vector<std::vector <COOR> > & steinerpoints,
+   std::vector<std::pair<size_t, size_t> > & edges);
+
+#endif
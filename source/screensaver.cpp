@@ -20,10 +20,19 @@
  * SOFTWARE.
  ******************************************************************************/
 
+#define GL_GLEXT_PROTOTYPES
 #include <SDL/SDL.h>
 #include <SDL/SDL_opengl.h>
 #include <math.h>
+#include <stddef.h>
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
 #include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
 #include <vector>
 #include <stdlib.h>
 #include "dijkstra_steiner.h"
@@ -48,34 +57,99 @@ bool pollEvents()
   return true;
 }
 
-void draw_tube(float r, float g, float b)
+struct colored_vertex{
+   GLfloat _position[3];
+   GLfloat _color[3];
+};
+
+/*A triangle strip in a vertex buffer, built once and drawn for every instance*/
+struct mesh{
+   GLuint _buffer;
+   GLsizei _num_vertices;
+};
+
+/*Placement of one copy of a mesh, meshes point along the z-axis*/
+struct mesh_instance{
+   GLfloat _translation[3];
+   GLfloat _scale[3];
+   uint8_t _axis;
+};
+
+/*Joins the strips with degenerate triangles, so a mesh is drawn as a single strip*/
+void append_strip(std::vector<colored_vertex> const & strip, std::vector<colored_vertex> & vertices)
+{
+   if (!vertices.empty() && !strip.empty())
+   {
+      colored_vertex last = vertices.back();
+      vertices.push_back(last);
+      vertices.push_back(strip.front());
+   }
+   vertices.insert(vertices.end(), strip.begin(), strip.end());
+}
+
+void build_tube(float r, float g, float b, std::vector<colored_vertex> & vertices)
 {
    size_t resolution = 64;
-   glBegin(GL_TRIANGLE_STRIP);
    double mult = 2 * M_PI / resolution;
+   std::vector<colored_vertex> strip;
    for (size_t i = 0; i <= resolution; ++i)
-   { 
-        glColor3f(r * (sin(i * mult) * 0.5 + 0.5), g * (sin(i * mult) * 0.5 + 0.5), b * (sin(i * mult) * 0.5 + 0.5));
-        glVertex3f(sin(i * mult), cos(i * mult), -1);
-        glVertex3f(sin(i *mult), cos(i * mult), 1);
+   {
+      GLfloat shade = sin(i * mult) * 0.5 + 0.5;
+      strip.push_back({{GLfloat(sin(i * mult)), GLfloat(cos(i * mult)), -1}, {r * shade, g * shade, b * shade}});
+      strip.push_back({{GLfloat(sin(i * mult)), GLfloat(cos(i * mult)), 1}, {r * shade, g * shade, b * shade}});
    }
-   glEnd();
+   append_strip(strip, vertices);
 }
 
-void draw_sphere(float r, float g, float b)
+void build_sphere(float r, float g, float b, std::vector<colored_vertex> & vertices)
 {
    size_t resolution = 16;
    double mult = M_PI / resolution;
-   for (size_t i = 0; i <= resolution; ++i)
-   { 
-      glBegin(GL_TRIANGLE_STRIP);
+   std::vector<colored_vertex> strip;
+   for (size_t i = 0; i < resolution; ++i)
+   {
+      strip.clear();
       for (size_t j = 0; j <= resolution * 2; ++j)
       {
-         glColor3f(r, g * (cos(j * mult) * 0.5 + 0.5), b * ( sin(i * mult) * 0.5 + 0.5 ));
-         glVertex3f(sin(j * mult) * sin(i * mult), cos(j * mult) * sin(i * mult), cos(i * mult));
-         glVertex3f(sin(j * mult) * sin((i + 1) * mult), cos(j * mult) * sin((i + 1) * mult), cos((i + 1) * mult));
+         GLfloat color[3] = {r, GLfloat(g * (cos(j * mult) * 0.5 + 0.5)), GLfloat(b * (sin(i * mult) * 0.5 + 0.5))};
+         strip.push_back({{GLfloat(sin(j * mult) * sin(i * mult)), GLfloat(cos(j * mult) * sin(i * mult)), GLfloat(cos(i * mult))}, {color[0], color[1], color[2]}});
+         strip.push_back({{GLfloat(sin(j * mult) * sin((i + 1) * mult)), GLfloat(cos(j * mult) * sin((i + 1) * mult)), GLfloat(cos((i + 1) * mult))}, {color[0], color[1], color[2]}});
       }
-      glEnd();
+      append_strip(strip, vertices);
+   }
+}
+
+mesh upload_mesh(std::vector<colored_vertex> const & vertices)
+{
+   mesh result;
+   glGenBuffers(1, &result._buffer);
+   glBindBuffer(GL_ARRAY_BUFFER, result._buffer);
+   glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(colored_vertex), vertices.data(), GL_STATIC_DRAW);
+   result._num_vertices = vertices.size();
+   return result;
+}
+
+/*The fixed function pipeline has no per instance attributes, each instance sets the modelview matrix and draws the shared buffer*/
+void draw_instances(mesh const & m, std::vector<mesh_instance> const & instances)
+{
+   glBindBuffer(GL_ARRAY_BUFFER, m._buffer);
+   glVertexPointer(3, GL_FLOAT, sizeof(colored_vertex), reinterpret_cast<const GLvoid*>(offsetof(colored_vertex, _position)));
+   glColorPointer(3, GL_FLOAT, sizeof(colored_vertex), reinterpret_cast<const GLvoid*>(offsetof(colored_vertex, _color)));
+   for (mesh_instance const & instance : instances)
+   {
+      glPushMatrix();
+      glTranslatef(instance._translation[0], instance._translation[1], instance._translation[2]);
+      if (instance._axis == 0)
+      {
+         glRotatef(90, 0, 1, 0);
+      }
+      else if (instance._axis == 1)
+      {
+         glRotatef(90, 1, 0, 0);
+      }
+      glScalef(instance._scale[0], instance._scale[1], instance._scale[2]);
+      glDrawArrays(GL_TRIANGLE_STRIP, 0, m._num_vertices);
+      glPopMatrix();
    }
 }
 
@@ -93,8 +167,185 @@ struct tube_coordinate_3d{
    uint8_t direction;
 };
 
-int main(int , char **)
+/*Terminals drifting randomly, pulled back to the origin and slowed down*/
+struct terminal_motion{
+    std::vector<std::vector<COOR> > _coordinates;
+    std::vector<std::vector<COOR> > _speed;
+
+    terminal_motion(size_t num_terminals)
+    {
+        for (size_t i = 0; i < num_terminals; ++i)
+        {
+            std::vector<COOR> coor = {rand() % 10, rand() % 10, rand() % 10};
+            _coordinates.push_back(coor);
+            _speed.push_back({0,0,0});
+        }
+    }
+
+    void step()
+    {
+        for (size_t i = 0; i < _coordinates.size(); ++i)
+        {
+            for (size_t j = 0; j < 3; ++j)
+            {
+                _speed[i][j] += (rand() % 101) - 50 - _coordinates[i][j] / 30000 - _speed[i][j] / 1500;
+                _coordinates[i][j] += _speed[i][j];
+            }
+        }
+    }
+};
+
+/*A solved tree together with the terminals it was solved for*/
+struct tree_snapshot{
+    std::vector<std::vector<COOR> > _terminals;
+    std::vector<std::vector<COOR> > _steinerpoints;
+    std::vector<std::pair<size_t, size_t> > _edges;
+};
+
+/*Solves the newest terminals on a background thread, the renderer picks up the newest completed tree without waiting*/
+class AsyncSolver{
+public:
+    AsyncSolver(dijkstra_steiner_settings const & settings) : _settings(settings), _has_terminals(false), _has_completed(false), _stop(false)
+    {
+        _thread = std::thread(&AsyncSolver::run, this);
+    }
+
+    ~AsyncSolver()
+    {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _stop = true;
+        }
+        _wakeup.notify_one();
+        _thread.join();
+    }
+
+    AsyncSolver(AsyncSolver const &) = delete;
+    AsyncSolver & operator=(AsyncSolver const &) = delete;
+
+    /*Replaces the terminals waiting to be solved, older ones are skipped*/
+    void set_terminals(std::vector<std::vector<COOR> > const & terminals)
+    {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _terminals = terminals;
+            _has_terminals = true;
+        }
+        _wakeup.notify_one();
+    }
+
+    /*Swaps the newest completed tree into snapshot, false if none was completed since the last call*/
+    bool fetch(tree_snapshot & snapshot)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (!_has_completed)
+        {
+            return false;
+        }
+        std::swap(snapshot, _completed);
+        _has_completed = false;
+        return true;
+    }
+
+private:
+    void run()
+    {
+        tree_snapshot back;
+        while (true)
+        {
+            {
+                std::unique_lock<std::mutex> lock(_mutex);
+                _wakeup.wait(lock, [this]{return _stop || _has_terminals;});
+                if (_stop)
+                {
+                    return;
+                }
+                std::swap(back._terminals, _terminals);
+                _has_terminals = false;
+            }
+            try
+            {
+                calculate_steinertree(*boundingbox_lower_bound, back._terminals, _settings, back._steinerpoints, back._edges);
+            }
+            catch (std::exception const & ex)
+            {
+                std::cerr << "solve failed: " << ex.what() << std::endl;
+                continue;
+            }
+            std::lock_guard<std::mutex> lock(_mutex);
+            std::swap(back, _completed);
+            _has_completed = true;
+        }
+    }
+
+    dijkstra_steiner_settings _settings;
+    std::vector<std::vector<COOR> > _terminals;
+    tree_snapshot _completed;
+    bool _has_terminals;
+    bool _has_completed;
+    bool _stop;
+    std::mutex _mutex;
+    std::condition_variable _wakeup;
+    std::thread _thread;
+};
+
+/*Solves the moving terminals without a display and reports the throughput and latency percentiles*/
+int run_headless(dijkstra_steiner_settings const & settings, size_t num_solves)
 {
+    terminal_motion motion(8);
+    std::vector<std::vector<COOR> > steinerpoint_coordinates;
+    std::vector<std::pair<size_t, size_t> > edges;
+    std::vector<double> latencies;
+    latencies.reserve(num_solves);
+    std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < num_solves; ++i)
+    {
+        motion.step();
+        std::chrono::steady_clock::time_point solve_begin = std::chrono::steady_clock::now();
+        calculate_steinertree(*boundingbox_lower_bound, motion._coordinates, settings, steinerpoint_coordinates, edges);
+        latencies.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - solve_begin).count());
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+    if (latencies.empty())
+    {
+        return 0;
+    }
+    std::sort(latencies.begin(), latencies.end());
+    std::cout << "solves " << num_solves << " in " << seconds << " s, " << num_solves / seconds << " solves/s" << std::endl;
+    std::cout << "latency ms p50 " << latencies[latencies.size() / 2] << " p90 " << latencies[latencies.size() * 9 / 10] << " p99 " << latencies[latencies.size() * 99 / 100] << " max " << latencies.back() << std::endl;
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    dijkstra_steiner_settings settings;
+    settings._small_memory_mode = false;  //deletes object when possible, less memory use but higher runtime
+    settings._maximum_heap_width = 20;    //lower values can result in less memory consumption but increase runtime
+    settings._edge_as_steinerpoint = false;
+
+    bool headless = false;
+    size_t num_solves = 2000;
+    for (int i = 1; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "--headless") == 0)
+        {
+            headless = true;
+        }
+        else if (strcmp(argv[i], "--solves") == 0 && i + 1 < argc)
+        {
+            num_solves = std::stoul(argv[++i]);
+        }
+        else
+        {
+            std::cout << "screensaver [--headless] [--solves <number>]" << std::endl;
+            return 1;
+        }
+    }
+    if (headless)
+    {
+        return run_headless(settings, num_solves);
+    }
+
     if( SDL_Init( SDL_INIT_VIDEO ) != 0 )
     {
         std::cout << "Can't load sld " << SDL_GetError() << ')' << std::endl;
@@ -109,6 +360,21 @@ int main(int , char **)
 
     glClearColor( 0.0, 0.0, 0.0, 0.0 );
     glEnable( GL_DEPTH_TEST );
+    glEnableClientState( GL_VERTEX_ARRAY );
+    glEnableClientState( GL_COLOR_ARRAY );
+
+    std::vector<colored_vertex> vertices;
+    build_sphere(0, 1, 1, vertices);
+    mesh terminal_mesh = upload_mesh(vertices);
+    vertices.clear();
+    build_sphere(1, 1, 0, vertices);
+    mesh steiner_mesh = upload_mesh(vertices);
+    vertices.clear();
+    build_sphere(1, 1, 1, vertices);
+    mesh eckpoint_mesh = upload_mesh(vertices);
+    vertices.clear();
+    build_tube(1, 1, 1, vertices);
+    mesh connection_mesh = upload_mesh(vertices);
 
     glMatrixMode( GL_PROJECTION );
     glLoadIdentity();
@@ -121,27 +387,31 @@ int main(int , char **)
 
     glTranslatef(0,0,-800000);
     glRotatef(60,1,1,0);
-    std::vector<std::vector<COOR> > terminal_coordinates;
-    std::vector<std::vector<COOR> > terminal_speed;
-    for (size_t i = 0; i < 8; ++i)
-    {
-        std::vector<COOR> coor = {rand() % 10, rand() % 10, rand() % 10};
-        terminal_coordinates.push_back(coor);
-        terminal_speed.push_back({0,0,0});
-    }
+    terminal_motion motion(8);
     
-    double terminal_radius = 16000;
-    double steiner_radius = 10000;
-    double eckpoint_radius = 5000;
-    double connection_radius = 5000;
+    GLfloat terminal_radius = 16000;
+    GLfloat steiner_radius = 10000;
+    GLfloat eckpoint_radius = 5000;
+    GLfloat connection_radius = 5000;
 
-    std::vector<std::vector<COOR> > steinerpoint_coordinates;
-    std::vector<std::pair<size_t, size_t> > edges;
+    /*The terminals move every frame, the tree shown is the newest one the solver completed*/
+    tree_snapshot snapshot;
+    AsyncSolver solver(settings);
+    std::vector<std::vector<COOR> > const & terminal_coordinates = snapshot._terminals;
+    std::vector<std::vector<COOR> > const & steinerpoint_coordinates = snapshot._steinerpoints;
+    std::vector<std::pair<size_t, size_t> > const & edges = snapshot._edges;
 
-    dijkstra_steiner_settings settings;
-    settings._small_memory_mode = false;  //deletes object when possible, less memory use but higher runtime
-    settings._maximum_heap_width = 20;    //lower values can result in less memory consumption but increase runtime
-    settings._edge_as_steinerpoint = false;
+    std::vector<mesh_instance> terminal_instances;
+    std::vector<mesh_instance> steiner_instances;
+    std::vector<mesh_instance> eckpoint_instances;
+    std::vector<mesh_instance> connection_instances;
+
+    /*Frame times including the swap, averaged over a few seconds*/
+    size_t const frames_per_report = 300;
+    size_t num_frames = 0;
+    double frame_time_sum = 0;
+    double frame_time_max = 0;
+    std::chrono::steady_clock::time_point frame_begin = std::chrono::steady_clock::now();
 
     while(true)
     {
@@ -150,36 +420,23 @@ int main(int , char **)
         glClear( GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT );
         glRotatef(0.01,0,0,1);
 
+        motion.step();
+        solver.set_terminals(motion._coordinates);
+        solver.fetch(snapshot);
         
+        terminal_instances.clear();
+        steiner_instances.clear();
+        eckpoint_instances.clear();
+        connection_instances.clear();
         for (size_t i = 0; i < terminal_coordinates.size(); ++i)
         {
-            terminal_speed[i][0] += (rand() % 101) - 50 - terminal_coordinates[i][0] / 30000 - terminal_speed[i][0] / 1500;
-            terminal_speed[i][1] += (rand() % 101) - 50 - terminal_coordinates[i][1] / 30000 - terminal_speed[i][1] / 1500;
-            terminal_speed[i][2] += (rand() % 101) - 50 - terminal_coordinates[i][2] / 30000 - terminal_speed[i][2] / 1500;
-            terminal_coordinates[i][0] += terminal_speed[i][0]; 
-            terminal_coordinates[i][1] += terminal_speed[i][1];
-            terminal_coordinates[i][2] += terminal_speed[i][2];
-        }
-            
-        calculate_steinertree(*boundingbox_lower_bound, terminal_coordinates, settings, steinerpoint_coordinates, edges);
-        
-        for (size_t i = 0; i < terminal_coordinates.size(); ++i)
-        {
-            glPushMatrix();
             std::vector<int> const & coor = terminal_coordinates[i];
-            glTranslatef(coor[0], coor[1], coor[2]);
-            glScalef(terminal_radius, terminal_radius, terminal_radius);
-            draw_sphere(0, 1, 1);
-            glPopMatrix();
+            terminal_instances.push_back({{GLfloat(coor[0]), GLfloat(coor[1]), GLfloat(coor[2])}, {terminal_radius, terminal_radius, terminal_radius}, 2});
         }
         for (size_t i = 0; i < steinerpoint_coordinates.size(); ++i)
         {
-            glPushMatrix();
             std::vector<int> const & coor = steinerpoint_coordinates[i];
-            glTranslatef(coor[0], coor[1], coor[2]);
-            glScalef(steiner_radius, steiner_radius, steiner_radius);
-            draw_sphere(1, 1, 0);
-            glPopMatrix();
+            steiner_instances.push_back({{GLfloat(coor[0]), GLfloat(coor[1]), GLfloat(coor[2])}, {steiner_radius, steiner_radius, steiner_radius}, 2});
         }
         for (size_t i = 0; i < edges.size(); ++i)
         {
@@ -193,37 +450,41 @@ int main(int , char **)
                 {
                     if (draw_connection)
                     {
-                        glPushMatrix();
-                        glTranslatef(j < 1 ? c0[0] : c1[0], j < 2 ? c0[1] : c1[1], j < 3 ? c0[2] : c1[2]);
-                        glScalef(eckpoint_radius, eckpoint_radius, eckpoint_radius);
-                        draw_sphere(1,1,1);
-                        glPopMatrix();
+                        eckpoint_instances.push_back({{GLfloat(j < 1 ? c0[0] : c1[0]), GLfloat(j < 2 ? c0[1] : c1[1]), GLfloat(j < 3 ? c0[2] : c1[2])}, {eckpoint_radius, eckpoint_radius, eckpoint_radius}, 2});
                     }
                     draw_connection = true;
-                    glPushMatrix();
                     double posx = ((j > 0 ? c1[0] : c0[0]) + c1[0]) * 0.5;
                     double posy = ((j > 1 ? c1[1] : c0[1]) + (j > 0 ? c1[1] : c0[1])) * 0.5;
                     double posz = (c0[2] + (j > 1 ? c1[2] : c0[2])) * 0.5;
-                    glTranslatef(posx, posy, posz);
-                    if (j == 0)
-                    {
-                        glRotatef(90, 0, 1, 0);
-                    }
-                    else if (j == 1)
-                    {
-                        glRotatef(90, 1, 0, 0);
-                    }
-                    glScalef(connection_radius, connection_radius, 0.5 * std::abs(c0[j] - c1[j]));
-                    draw_tube(1, 1, 1);
-                    glPopMatrix();
+                    connection_instances.push_back({{GLfloat(posx), GLfloat(posy), GLfloat(posz)}, {connection_radius, connection_radius, GLfloat(0.5 * std::abs(c0[j] - c1[j]))}, uint8_t(j)});
                 }
             }
         }
-        steinerpoint_coordinates.clear();
-        edges.clear();
+        draw_instances(terminal_mesh, terminal_instances);
+        draw_instances(steiner_mesh, steiner_instances);
+        draw_instances(eckpoint_mesh, eckpoint_instances);
+        draw_instances(connection_mesh, connection_instances);
         SDL_GL_SwapBuffers();
+
+        std::chrono::steady_clock::time_point frame_end = std::chrono::steady_clock::now();
+        double frame_time = std::chrono::duration<double, std::milli>(frame_end - frame_begin).count();
+        frame_begin = frame_end;
+        frame_time_sum += frame_time;
+        frame_time_max = std::max(frame_time_max, frame_time);
+        if (++num_frames == frames_per_report)
+        {
+            std::cout << "frame ms avg " << frame_time_sum / num_frames << " max " << frame_time_max << std::endl;
+            num_frames = 0;
+            frame_time_sum = 0;
+            frame_time_max = 0;
+        }
     }
 
+    glDeleteBuffers(1, &terminal_mesh._buffer);
+    glDeleteBuffers(1, &steiner_mesh._buffer);
+    glDeleteBuffers(1, &eckpoint_mesh._buffer);
+    glDeleteBuffers(1, &connection_mesh._buffer);
+
     SDL_Quit();
     return 0;
 }
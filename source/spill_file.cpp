@@ -0,0 +1,95 @@
+/*******************************************************************************
+ * Copyright (c) 2019 Paul Stahr
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ ******************************************************************************/
+
+#include <stdexcept>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include "spill_file.h"
+
+/*The file grows geometrically between these step sizes, each step is mapped separately*/
+static const size_t spill_min_chunk_bytes = size_t(1) << 20;
+static const size_t spill_max_chunk_bytes = size_t(1) << 28;
+
+SpillFile::SpillFile(std::string const & directory, size_t reserved_bytes) : _fd(-1), _begin(nullptr), _size(0), _mapped(0), _reserved(reserved_bytes)
+{
+   std::string pattern = directory + "/dijkstra_steiner_spill_XXXXXX";
+   std::vector<char> path(pattern.begin(), pattern.end());
+   path.push_back('\0');
+   _fd = mkstemp(path.data());
+   if (_fd == -1)
+   {
+      throw std::runtime_error("Can't create spill file in " + directory + ": " + std::strerror(errno));
+   }
+   unlink(path.data());
+   void *begin = mmap(nullptr, _reserved, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+   if (begin == MAP_FAILED)
+   {
+      close(_fd);
+      throw std::runtime_error(std::string("Can't reserve address range for spill file: ") + std::strerror(errno));
+   }
+   _begin = static_cast<char*>(begin);
+}
+
+SpillFile::~SpillFile()
+{
+   munmap(_begin, _reserved);
+   close(_fd);
+}
+
+/*Keep records aligned for any member type*/
+static size_t aligned_bytes(size_t bytes)
+{
+   return (bytes + alignof(std::max_align_t) - 1) & ~(alignof(std::max_align_t) - 1);
+}
+
+bool SpillFile::fits(size_t bytes) const
+{
+   return _size + aligned_bytes(bytes) <= _reserved;
+}
+
+void* SpillFile::append(size_t bytes)
+{
+   bytes = aligned_bytes(bytes);
+   if (_size + bytes > _mapped)
+   {
+      if (_size + bytes > _reserved)
+      {
+         throw std::runtime_error("Spill file exceeds reserved address range");
+      }
+      size_t chunk_bytes = std::min(std::max(_mapped, spill_min_chunk_bytes), spill_max_chunk_bytes);
+      size_t mapped = std::min(_mapped + ((_size + bytes - _mapped + chunk_bytes - 1) / chunk_bytes) * chunk_bytes, _reserved);
+      if (ftruncate(_fd, mapped) != 0
+       || mmap(_begin + _mapped, mapped - _mapped, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, _fd, _mapped) == MAP_FAILED)
+      {
+         throw std::runtime_error(std::string("Can't grow spill file: ") + std::strerror(errno));
+      }
+      _mapped = mapped;
+   }
+   void *result = _begin + _size;
+   _size += bytes;
+   return result;
+}
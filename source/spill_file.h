@@ -0,0 +1,54 @@
+/*******************************************************************************
+ * Copyright (c) 2019 Paul Stahr
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ ******************************************************************************/
+
+#ifndef SPILL_FILE_H
+#define SPILL_FILE_H
+
+#include <cstddef>
+#include <string>
+
+/*Append only storage in an unlinked temporary file. The file is mapped into an address range reserved up front,
+so records keep their address while the file grows and the kernel can write cold pages back instead of keeping them in memory*/
+class SpillFile{
+public:
+   SpillFile(std::string const & directory, size_t reserved_bytes);
+   ~SpillFile();
+
+   SpillFile(SpillFile const &) = delete;
+   SpillFile & operator=(SpillFile const &) = delete;
+
+   void* append(size_t bytes);
+
+   /*Whether append of this many bytes stays in the reserved address range*/
+   bool fits(size_t bytes) const;
+
+   size_t size() const{return _size;}
+
+private:
+   int _fd;
+   char *_begin;
+   size_t _size;
+   size_t _mapped;
+   size_t _reserved;
+};
+
+#endif
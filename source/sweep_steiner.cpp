@@ -0,0 +1,202 @@
+/*******************************************************************************
+ * Copyright (c) 2019 Paul Stahr
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ ******************************************************************************/
+
+#include <vector>
+#include <limits>
+#include <stdexcept>
+#include <algorithm>
+#include "sweep_steiner.h"
+
+/*Half of the maximum, so the sum of two unreachable entries doesn't overflow*/
+static const DISTANCE_T sweep_infinity = std::numeric_limits<DISTANCE_T>::max() / 2;
+
+/*Grid structure for the sweeps, the gaps are the distances between consecutive coordinates of an axis*/
+struct sweep_grid{
+   size_t _num_vertices;
+   std::vector<size_t> _sizes;
+   std::vector<size_t> _steps;
+   std::vector<std::vector<DISTANCE_T> > _gaps;
+};
+
+static void sweep(sweep_grid const & grid, DISTANCE_T *cost)
+{
+   for (size_t axis = 0; axis < grid._sizes.size(); ++axis)
+   {
+      size_t size = grid._sizes[axis];
+      size_t inner = grid._steps[axis];
+      size_t outer = grid._num_vertices / (inner * size);
+      DISTANCE_T const *gaps = grid._gaps[axis].data();
+      for (size_t o = 0; o < outer; ++o)
+      {
+         DISTANCE_T *line = cost + o * size * inner;
+         for (size_t i = 1; i < size; ++i)
+         {
+            DISTANCE_T *current = line + i * inner;
+            DISTANCE_T const *previous = current - inner;
+            DISTANCE_T gap = gaps[i - 1];
+            for (size_t j = 0; j < inner; ++j)
+            {
+               current[j] = std::min(current[j], previous[j] + gap);
+            }
+         }
+         for (size_t i = size - 1; i --> 0;)
+         {
+            DISTANCE_T *current = line + i * inner;
+            DISTANCE_T const *next = current + inner;
+            DISTANCE_T gap = gaps[i];
+            for (size_t j = 0; j < inner; ++j)
+            {
+               current[j] = std::min(current[j], next[j] + gap);
+            }
+         }
+      }
+   }
+}
+
+DISTANCE_T calculate_steinertree_sweep(
+   steiner_instance const & instance,
+   std::vector<std::pair<size_t, size_t> > & edges)
+{
+   size_t num_terminals = instance._terminals.size();
+   if (num_terminals <= 1)
+   {
+      return 0;
+   }
+   size_t num_keyed_terminals = num_terminals - 1;
+   if (num_keyed_terminals >= 32)
+   {
+      throw std::runtime_error("Too many terminals for subset dynamic program");
+   }
+   sweep_grid grid;
+   grid._num_vertices = instance._vertices.size();
+   grid._sizes = instance._sizes;
+   sizes_to_steps(grid._sizes, grid._steps);
+   size_t dim = grid._sizes.size();
+   size_t num_vertices = grid._num_vertices;
+   grid._gaps.resize(dim);
+   for (size_t axis = 0; axis < dim; ++axis)
+   {
+      for (size_t i = 0; i + 1 < grid._sizes[axis]; ++i)
+      {
+         grid._gaps[axis].push_back(instance._vertices[(i + 1) * grid._steps[axis]]._coords[axis] - instance._vertices[i * grid._steps[axis]]._coords[axis]);
+      }
+   }
+   /*Added to the combinations with max, makes excluded vertices unusable as merge points*/
+   std::vector<DISTANCE_T> excluded_mask(num_vertices);
+   for (size_t v = 0; v < num_vertices; ++v)
+   {
+      excluded_mask[v] = instance._vertices[v]._is_excluded ? sweep_infinity : 0;
+   }
+
+   BITSET num_subsets = BITSET(1) << num_keyed_terminals;
+   std::vector<DISTANCE_T> cost(num_subsets * num_vertices, sweep_infinity);
+   for (size_t i = 0; i < num_keyed_terminals; ++i)
+   {
+      DISTANCE_T *subset_cost = &cost[(BITSET(1) << i) * num_vertices];
+      subset_cost[instance._terminals[i]] = 0;
+      sweep(grid, subset_cost);
+   }
+   for (size_t num_members = 2; num_members <= num_keyed_terminals; ++num_members)
+   {
+      /*Enumerate the subsets of this size in increasing order*/
+      for (BITSET subset = (BITSET(1) << num_members) - 1; subset < num_subsets;)
+      {
+         DISTANCE_T *subset_cost = &cost[subset * num_vertices];
+         BITSET lowest = subset & -subset;
+         for (BITSET part = (subset - 1) & subset; part != 0; part = (part - 1) & subset)
+         {
+            if (!(part & lowest))
+            {
+               continue;
+            }
+            DISTANCE_T const *part_cost = &cost[part * num_vertices];
+            DISTANCE_T const *rest_cost = &cost[(subset ^ part) * num_vertices];
+            for (size_t v = 0; v < num_vertices; ++v)
+            {
+               subset_cost[v] = std::min(subset_cost[v], part_cost[v] + rest_cost[v]);
+            }
+         }
+         for (size_t v = 0; v < num_vertices; ++v)
+         {
+            subset_cost[v] = std::max(subset_cost[v], excluded_mask[v]);
+         }
+         sweep(grid, subset_cost);
+
+         BITSET carry = subset + lowest;
+         subset = (((carry ^ subset) >> 2) / lowest) | carry;
+      }
+   }
+
+   BITSET all_terminal_key = num_subsets - 1;
+   size_t root = instance._terminals.back();
+   DISTANCE_T length = cost[all_terminal_key * num_vertices + root];
+   if (length >= sweep_infinity)
+   {
+      throw std::runtime_error("Terminals are not connected");
+   }
+
+   /*Follow splits and grid edges whose costs add up back to the terminals*/
+   std::vector<std::pair<BITSET, size_t> > stack(1, std::make_pair(all_terminal_key, root));
+   while (!stack.empty())
+   {
+      BITSET subset = stack.back().first;
+      size_t v = stack.back().second;
+      stack.pop_back();
+      DISTANCE_T current_cost = cost[subset * num_vertices + v];
+      if ((subset & (subset - 1)) == 0 && instance._terminals[__builtin_ctzll(subset)] == v)
+      {
+         continue;
+      }
+      bool found = false;
+      BITSET lowest = subset & -subset;
+      for (BITSET part = (subset - 1) & subset; part != 0 && !found; part = (part - 1) & subset)
+      {
+         if ((part & lowest) && cost[part * num_vertices + v] + cost[(subset ^ part) * num_vertices + v] == current_cost)
+         {
+            stack.emplace_back(part, v);
+            stack.emplace_back(subset ^ part, v);
+            found = true;
+         }
+      }
+      for (size_t axis = 0; axis < dim && !found; ++axis)
+      {
+         size_t index = (v / grid._steps[axis]) % grid._sizes[axis];
+         if (index > 0 && cost[subset * num_vertices + v - grid._steps[axis]] + grid._gaps[axis][index - 1] == current_cost)
+         {
+            edges.emplace_back(v, v - grid._steps[axis]);
+            stack.emplace_back(subset, v - grid._steps[axis]);
+            found = true;
+         }
+         else if (index + 1 < grid._sizes[axis] && cost[subset * num_vertices + v + grid._steps[axis]] + grid._gaps[axis][index] == current_cost)
+         {
+            edges.emplace_back(v, v + grid._steps[axis]);
+            stack.emplace_back(subset, v + grid._steps[axis]);
+            found = true;
+         }
+      }
+      if (!found)
+      {
+         throw std::runtime_error("Inconsistent subset table");
+      }
+   }
+   return length;
+}
@@ -24,12 +24,64 @@
 #include <limits>
 #include "util.h"
 
+void create_grid_vertices(std::vector<std::vector<COOR> > const & coords, steiner_instance & instance)
+{
+   size_t dim = coords.size();
+   instance._sizes.clear();
+   for (std::vector<COOR> const & co : coords)
+   {
+      instance._sizes.push_back(co.size());
+   }
+   size_t vertex_count = 1;
+   for (size_t size : instance._sizes)
+   {
+      vertex_count *= size;
+   }
+   instance._vertices.clear();
+   instance._vertices.resize(vertex_count);
+   /*Every vertex is written by exactly one thread, the result doesn't depend on the schedule*/
+   #pragma omp parallel
+   {
+      std::vector<size_t> indices(dim, 0);
+      size_t next = std::numeric_limits<size_t>::max();
+      #pragma omp for schedule(static)
+      for (size_t i = 0; i < vertex_count; ++i)
+      {
+         /*The position is only computed at the start of a chunk and incremented afterwards*/
+         if (i != next)
+         {
+            size_t index = i;
+            for (size_t j = 0; j < dim; ++j)
+            {
+               indices[j] = index % instance._sizes[j];
+               index /= instance._sizes[j];
+            }
+         }
+         vertex & current_v = instance._vertices[i];
+         current_v._coords.resize(dim);
+         for (size_t j = 0; j < dim; ++j)
+         {
+            current_v._coords[j] = coords[j][indices[j]];
+         }
+         current_v._is_excluded = false;
+         current_v._terminal_number = std::numeric_limits<uint8_t>::max();
+         for (size_t j = 0; j < dim && ++indices[j] == instance._sizes[j]; ++j)
+         {
+            indices[j] = 0;
+         }
+         next = i + 1;
+      }
+   }
+}
+
 void update_neighbours(steiner_instance & instance)
 {
    size_t dim = instance._sizes.size();
    size_t vertex_count = instance._vertices.size();
    std::vector<size_t> step;
    sizes_to_steps(instance._sizes, step);
+   /*Only the neighbours of the own vertex are written, the others are only read*/
+   #pragma omp parallel for schedule(static)
    for (size_t i = 0; i < vertex_count; ++i)
    {
       vertex & current_vertex = instance._vertices[i];
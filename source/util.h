@@ -58,6 +58,9 @@ std::string print_vec(std::vector<T> data);
 template< class T >
 T multiply(std::vector<T> const & vec);
 
+/*Creates the vertices of the grid spanned by the sorted coordinates of each axis, the first axis varies fastest*/
+void create_grid_vertices(std::vector<std::vector<COOR> > const & coords, steiner_instance & instance);
+
 void update_neighbours(steiner_instance & instance);
 
 size_t calculate_index(std::vector<size_t> const & sizes, std::vector<size_t> const & indices);